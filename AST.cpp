@@ -7,13 +7,10 @@
 //
 
 #include "AST.h"
-#include "CodeGenerator.h"
+#include "ASTVisitor.h"
 #include "llvm/Support/raw_ostream.h"
 
-using llvm::Value;
-using llvm::Function;
 using llvm::raw_ostream;
-using code_generator::CodeGenerator;
 
 namespace AST {
    
@@ -26,12 +23,39 @@ namespace AST {
    
    
    ///
-   /// Default ExprAST constructor (it creates a instance of the code generator)
+   /// ExprAST
    ///
-   ExprAST::ExprAST(CodeGenerator& codeGenerator) :
-      codeGenerator_(codeGenerator)
+   
+   namespace
+   {
+      ///
+      /// @brief: forward dump() to the concrete node
+      ///
+      class Dumper : public ASTVisitor<Dumper, raw_ostream&>
+      {
+      public:
+         raw_ostream& visitNumberExpr(const NumberExprAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+         raw_ostream& visitVariableExpr(const VariableExprAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+         raw_ostream& visitUnaryExpr(const UnaryExprAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+         raw_ostream& visitBinaryExpr(const BinaryExprAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+         raw_ostream& visitCallExpr(const CallExprAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+         raw_ostream& visitIfExpr(const IfExprAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+         raw_ostream& visitForExpr(const ForExprAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+         raw_ostream& visitVarExpr(const VarExprAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+         raw_ostream& visitPrototype(const PrototypeAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+         raw_ostream& visitFunction(const FunctionAST* node, raw_ostream& out, int ind) { return node->dump(out, ind); }
+      };
+   }
+   
+   ExprAST::ExprAST(Kind kind) :
+      kind_(kind)
    {}
    
+   ExprAST::Kind ExprAST::getKind() const
+   {
+      return kind_;
+   }
+   
    int ExprAST::getLine() const
    {
       return 0; //location_.line;
@@ -42,7 +66,12 @@ namespace AST {
       return 0;// location_.col;
    }
    
-   raw_ostream &ExprAST::dump(raw_ostream &out, int index)
+   raw_ostream &ExprAST::dump(raw_ostream &out, int ind) const
+   {
+      return Dumper().visit(this, out, ind);
+   }
+   
+   raw_ostream &ExprAST::dumpLocation(raw_ostream &out, int index) const
    {
      return out << ':' << getLine() << ':' << getCol() << '\n';
    }
@@ -51,8 +80,8 @@ namespace AST {
    /// Numeric expression AST node
    ///
    
-   NumberExprAST::NumberExprAST(CodeGenerator& codeGenerator, double val):
-   ExprAST(codeGenerator),
+   NumberExprAST::NumberExprAST(double val):
+   ExprAST(NumberKind),
    val_(val)
    {}
    
@@ -61,82 +90,70 @@ namespace AST {
       return val_;
    }
    
-   raw_ostream& NumberExprAST::dump(raw_ostream &out, int ind)
+   raw_ostream& NumberExprAST::dump(raw_ostream &out, int ind) const
    {
-      return ExprAST::dump(out << val_, ind);
+      return dumpLocation(out << val_, ind);
    }
 
    
-   Value* NumberExprAST::codeGen() const
-   {
-      return codeGenerator_.codeGenNumberExpr(this);
-   }
    
    ///
    /// Variable expression
    ///
    
-   VariableExprAST::VariableExprAST(CodeGenerator& codeGenerator, const std::string& name) :
-   ExprAST(codeGenerator),
+   VariableExprAST::VariableExprAST(util::Symbol name) :
+   ExprAST(VariableKind),
    name_(name)
    {}
    
-   const std::string& VariableExprAST::getName() const
+   util::Symbol VariableExprAST::getName() const
    {
       return name_;
    }
    
-   raw_ostream &VariableExprAST::dump(raw_ostream &out, int ind)
+   raw_ostream &VariableExprAST::dump(raw_ostream &out, int ind) const
    {
-      return ExprAST::dump(out << name_, ind);
+      return dumpLocation(out << name_.str(), ind);
    }
 
-   Value* VariableExprAST::codeGen() const
-   {
-      return codeGenerator_.codeGenVariableExpr(this);
-   }
    
    ///
    /// Unary expression
    ///
    
-   UnaryExprAST::UnaryExprAST(CodeGenerator& codeGenerator, opcode_t opcode, operand_t operand) :
-   ExprAST(codeGenerator),
+   UnaryExprAST::UnaryExprAST(opcode_t opcode, operand_t operand) :
+   ExprAST(UnaryKind),
    opcode_(opcode),
-   operand_(std::move(operand))
+   operand_(operand)
    {}
    
    UnaryExprAST::opcode_t UnaryExprAST::getOpcode() const
    {
       return opcode_;
    }
-   const UnaryExprAST::operand_t& UnaryExprAST::getOperand() const
+   UnaryExprAST::operand_t UnaryExprAST::getOperand() const
    {
       return operand_;
    }
    
-   raw_ostream &UnaryExprAST::dump(raw_ostream &out, int ind)
+   raw_ostream &UnaryExprAST::dump(raw_ostream &out, int ind) const
    {
-      ExprAST::dump(out << "unary" << opcode_, ind);
+      dumpLocation(out << "unary" << opcode_, ind);
       operand_->dump(out, ind + 1);
       return out;
    }
    
-   llvm::Value *UnaryExprAST::codeGen() const
-   {
-      return codeGenerator_.codeGenUnaryExpr(this);
-   }
    
    
    ///
    /// Binary expression
    ///
    
-   BinaryExprAST::BinaryExprAST(CodeGenerator& codeGenerator, opcode_t opcode, operand_t lhs, operand_t rhs) :
-   ExprAST(codeGenerator),
+   BinaryExprAST::BinaryExprAST(opcode_t opcode, operand_t lhs, operand_t rhs) :
+   ExprAST(BinaryKind),
    opcode_(opcode),
-   lhs_(std::move(lhs)),
-   rhs_(std::move(rhs))
+   lhs_(lhs),
+   rhs_(rhs)
    {}
       
    BinaryExprAST::opcode_t BinaryExprAST::getOpcode() const
@@ -144,89 +161,85 @@ namespace AST {
       return opcode_;
    }
    
-   const BinaryExprAST::operand_t& BinaryExprAST::getLeftOperand() const
+   BinaryExprAST::operand_t BinaryExprAST::getLeftOperand() const
    {
       return lhs_;
    }
    
-   const BinaryExprAST::operand_t& BinaryExprAST::getRightOperand() const
+   BinaryExprAST::operand_t BinaryExprAST::getRightOperand() const
    {
       return rhs_;
    }
    
-   raw_ostream &BinaryExprAST::dump(raw_ostream &out, int ind)
+   raw_ostream &BinaryExprAST::dump(raw_ostream &out, int ind) const
    {
-      ExprAST::dump(out << "binary" << opcode_, ind);
+      dumpLocation(out << "binary" << opcode_, ind);
       lhs_->dump(indent(out, ind) << "LHS:", ind + 1);
       rhs_->dump(indent(out, ind) << "RHS:", ind + 1);
       return out;
    }
 
-   llvm::Value* BinaryExprAST::codeGen() const
-   {
-      return codeGenerator_.codeGenBinaryExpr(this);
-   }
    
    ///
    /// Call expression
    ///
 
-   CallExprAST::CallExprAST(CodeGenerator& codeGenerator, const std::string& callee, Args args) :
-   ExprAST(codeGenerator),
+   CallExprAST::CallExprAST(util::Symbol callee, Args args) :
+   ExprAST(CallKind),
    callee_(callee),
-   args_(std::move(args))
+   args_(args)
    {}
       
-   const CallExprAST::Args& CallExprAST::getArgumentList() const
+   CallExprAST::Args CallExprAST::getArgumentList() const
    {
       return args_;
    }
    
-   const std::string CallExprAST::getCallee() const
+   util::Symbol CallExprAST::getCallee() const
    {
       return callee_;
    }
    
-   raw_ostream &CallExprAST::dump(raw_ostream &out, int ind)
+   raw_ostream &CallExprAST::dump(raw_ostream &out, int ind) const
    {
-      ExprAST::dump(out << "Call" << callee_, ind);
+      dumpLocation(out << "Call" << callee_.str(), ind);
       for (const auto &arg : args_)
          arg->dump( indent(out, ind+1), ind+1);
       return out;
    }
 
    
-   llvm::Value* CallExprAST::codeGen() const
-   {
-      return codeGenerator_.codeGenCallExpr(this);
-   }
    
    ///
    /// Prototype AST
    ///
 
-   PrototypeAST::PrototypeAST( CodeGenerator& codeGenerator,
-                               std::string name,
-                               PrototypeAST::Args args,
-                               bool is_operator,
-                               unsigned precedence) :
-      ExprAST(codeGenerator),
-      name_(std::move(name)),
-      args_(std::move(args)),
+   PrototypeAST::PrototypeAST(util::Symbol name,
+                              PrototypeAST::Args args,
+                              bool is_operator,
+                              unsigned precedence) :
+      ExprAST(PrototypeKind),
+      name_(name),
+      args_(args),
       is_operator_(is_operator),
       precedence_(precedence)
    {}
       
-   const PrototypeAST::Args& PrototypeAST::getArgumentList() const
+   PrototypeAST::Args PrototypeAST::getArgumentList() const
    {
       return args_;
    }
    
-   const std::string& PrototypeAST::getName() const
+   util::Symbol PrototypeAST::getName() const
    {
       return name_;
    }
    
+   bool PrototypeAST::isOperator() const
+   {
+      return is_operator_;
+   }
+   
    bool PrototypeAST::isUnary() const
    {
       return is_operator_ && args_.size() == 1;
@@ -245,38 +258,41 @@ namespace AST {
    char PrototypeAST::getOperatorName() const
    {
       assert(isUnary() || isBinary());
-      return name_[name_.size()-1];
+      return name_.str().back();
    }
    
-   
-   llvm::Function* PrototypeAST::codeGen() const
+   raw_ostream &PrototypeAST::dump(raw_ostream &out, int ind) const
    {
-      return codeGenerator_.codeGenPrototypeExpr(this);
+      dumpLocation(out << "prototype " << name_.str(), ind);
+      for (auto arg : args_)
+         indent(out, ind + 1) << arg.str() << '\n';
+      return out;
    }
    
+   
+   
    ///
    /// FunctionAST
    ///
    
-   FunctionAST::FunctionAST(CodeGenerator& codeGenerator,
-                            FunctionAST::prototype_t prototype,
+   FunctionAST::FunctionAST(FunctionAST::prototype_t prototype,
                             FunctionAST::body_t body) :
-      ExprAST(codeGenerator),
-      prototype_(std::move(prototype)),
-      body_(std::move(body))
+      ExprAST(FunctionKind),
+      prototype_(prototype),
+      body_(body)
    {}
    
-   const FunctionAST::prototype_t& FunctionAST::getPrototype() const
+   FunctionAST::prototype_t FunctionAST::getPrototype() const
    {
-      return std::move(prototype_);
+      return prototype_;
    } 
    
-   const FunctionAST::body_t& FunctionAST::getBody() const
+   FunctionAST::body_t FunctionAST::getBody() const
    {
       return body_;
    }
    
-   raw_ostream &FunctionAST::dump(raw_ostream &out, int ind)
+   raw_ostream &FunctionAST::dump(raw_ostream &out, int ind) const
    {
       indent(out, ind) << "FunctionAST\n";
       ++ind;
@@ -284,10 +300,6 @@ namespace AST {
       return body_ ? body_->dump(out, ind) : out << "null\n";
    }
    
-   llvm::Function* FunctionAST::codeGen() const
-   {
-      return codeGenerator_.codeGenFunctionExpr(this);
-   }
    
 //   void FunctionAST::eval(llvm::Function* f)
 //   {
@@ -298,91 +310,85 @@ namespace AST {
    /// IfExprAST
    ///
    
-   IfExprAST::IfExprAST(CodeGenerator& codeGenerator,
-                        condion_t c,
+   IfExprAST::IfExprAST(condion_t c,
                         then_branch_t t,
                         else_branch_t e) :
-   ExprAST(codeGenerator),
-   cond_(std::move(c)),
-   then_(std::move(t)),
-   else_(std::move(e))
+   ExprAST(IfKind),
+   cond_(c),
+   then_(t),
+   else_(e)
    {}
                                                    
-   const IfExprAST::condion_t& IfExprAST::getCondion() const
+   IfExprAST::condion_t IfExprAST::getCondion() const
    {
       return cond_;
    }
    
-   const IfExprAST::then_branch_t& IfExprAST::getThenBranch() const
+   IfExprAST::then_branch_t IfExprAST::getThenBranch() const
    {
       return then_;
    }
    
-   const IfExprAST::else_branch_t& IfExprAST::getElseBranch() const
+   IfExprAST::else_branch_t IfExprAST::getElseBranch() const
    {
       return else_;
    }
    
-   raw_ostream &IfExprAST::dump(raw_ostream &out, int ind)
+   raw_ostream &IfExprAST::dump(raw_ostream &out, int ind) const
    {
-      ExprAST::dump(out << "if", ind);
+      dumpLocation(out << "if", ind);
       cond_->dump(indent(out, ind) << "Cond:", ind + 1);
       then_->dump(indent(out, ind) << "Then:", ind + 1);
       else_->dump(indent(out, ind) << "Else:", ind + 1);
       return out;
    }
    
-   llvm::Value* IfExprAST::codeGen() const
-   {
-      return codeGenerator_.codeGenIfExpr(this);
-   }
    
    ///
    /// ForExprAST
    ///
    
-   ForExprAST::ForExprAST(CodeGenerator& codeGenerator,
-                       std::string keyLoop,
+   ForExprAST::ForExprAST(util::Symbol keyLoop,
                        expression_t start,
                        expression_t end,
                        expression_t step,
                        expression_t body) :
-   ExprAST(codeGenerator),
-   key_(std::move(keyLoop)),
-   start_(std::move(start)),
-   end_(std::move(end)),
-   step_(std::move(step)),
-   body_(std::move(body))
+   ExprAST(ForKind),
+   key_(keyLoop),
+   start_(start),
+   end_(end),
+   step_(step),
+   body_(body)
    {}
    
-   const std::string&  ForExprAST::getKey() const
+   util::Symbol ForExprAST::getKey() const
    {
       return key_;
    }
    
-   const ForExprAST::expression_t& ForExprAST::getStart() const
+   ForExprAST::expression_t ForExprAST::getStart() const
    {
       return start_;
    }
    
-   const ForExprAST::expression_t& ForExprAST::getEnd() const
+   ForExprAST::expression_t ForExprAST::getEnd() const
    {
       return end_;
    }
    
-   const ForExprAST::expression_t& ForExprAST::getStep() const
+   ForExprAST::expression_t ForExprAST::getStep() const
    {
       return step_;
    }
    
-   const ForExprAST::expression_t& ForExprAST::getBody() const
+   ForExprAST::expression_t ForExprAST::getBody() const
    {
       return body_;
    }
    
-   raw_ostream &ForExprAST::dump(raw_ostream &out, int ind)
+   raw_ostream &ForExprAST::dump(raw_ostream &out, int ind) const
    {
-      ExprAST::dump(out << "for", ind);
+      dumpLocation(out << "for", ind);
       start_->dump(indent(out, ind) << "Cond:", ind + 1);
       end_->dump(indent(out, ind) << "End:", ind + 1);
       step_->dump(indent(out, ind) << "Step:", ind + 1);
@@ -390,46 +396,37 @@ namespace AST {
       return out;
    }
 
-   llvm::Value* ForExprAST::codeGen() const
-   {
-      return codeGenerator_.codeGenForExpr(this);
-   }
    
    ///
    /// VarExprAST
    ///
    
-   VarExprAST::VarExprAST(CodeGenerator& codeGenerator,
-                          variable_names_t varNames, expression_t body) :
-   ExprAST(codeGenerator),
-   varNames_(std::move(varNames)),
-   body_(std::move(body))
+   VarExprAST::VarExprAST(variable_names_t varNames, expression_t body) :
+   ExprAST(VarKind),
+   varNames_(varNames),
+   body_(body)
    {}
    
-   const VarExprAST::variable_names_t& VarExprAST::getVarNames() const
+   VarExprAST::variable_names_t VarExprAST::getVarNames() const
    {
       return varNames_;
    }
    
-   const VarExprAST::expression_t& VarExprAST::getBody() const
+   VarExprAST::expression_t VarExprAST::getBody() const
    {
       return body_;
    }
    
-   raw_ostream &VarExprAST::dump(raw_ostream &out, int ind)
+   raw_ostream &VarExprAST::dump(raw_ostream &out, int ind) const
    {
-      ExprAST::dump(out << "var", ind);
+      dumpLocation(out << "var", ind);
       for (const auto &NamedVar : varNames_)
-         NamedVar.second->dump(indent(out, ind) << NamedVar.first << ':', ind+1);
+         NamedVar.second->dump(indent(out, ind) << NamedVar.first.str() << ':', ind+1);
       
       body_->dump(indent(out, ind) << "Body:", ind + 1);
       return out;
    }
    
-   llvm::Value* VarExprAST::codeGen() const
-   {
-      return codeGenerator_.codeGeneVarExpr(this);
-   }
 
 
 }
@@ -15,12 +15,8 @@
 #include <vector>
 #include <memory>
 
-#include "llvm/IR/Function.h"
-#include "llvm/IR/Value.h"
-
-namespace code_generator {
-   class CodeGenerator;
-}
+#include "llvm/ADT/ArrayRef.h"
+#include "Interner.h"
 
 namespace llvm{
    class raw_ostream;
@@ -30,24 +26,48 @@ namespace AST {
    
  
    ///
-   /// @brief: base class to for all expression nodes
+   /// @brief: base class to for all expression nodes.
+   ///         Nodes live in an ASTContext and refer to their children by plain pointers, they own
+   ///         nothing and are never destroyed one by one (hence no virtual destructor).
+   ///         Nodes know nothing about the backends lowering them: the kind of the node is all
+   ///         an ASTVisitor needs to dispatch on it
    ///
    class ExprAST
    {
       
    public:
-      explicit ExprAST(code_generator::CodeGenerator& codeGenerator);
-      
-      virtual ~ExprAST() = default;
       
+      enum Kind : unsigned char
+      {
+         NumberKind,
+         VariableKind,
+         UnaryKind,
+         BinaryKind,
+         CallKind,
+         IfKind,
+         ForKind,
+         VarKind,
+         PrototypeKind,
+         FunctionKind
+      };
+      
+      explicit ExprAST(Kind kind);
+      
+      Kind getKind() const;
       int getLine() const;
       int getCol() const;
-      virtual llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind);
       
-      virtual llvm::Value* codeGen() const = 0;
+      ///
+      /// @brief: print the tree rooted in this node
+      ///
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
    protected:
-      code_generator::CodeGenerator& codeGenerator_; //class that generates IR
+      
+      llvm::raw_ostream &dumpLocation(llvm::raw_ostream &out, int ind) const;
+      
+   private:
+      Kind kind_;
       //SourceLocation location_; //debug info
    };
    
@@ -58,10 +78,9 @@ namespace AST {
    {
       
    public:
-      explicit NumberExprAST(code_generator::CodeGenerator& codeGenerator, double val);
+      explicit NumberExprAST(double val);
       double getVal() const;
-      llvm::raw_ostream& dump(llvm::raw_ostream &out, int ind) override;
-      llvm::Value* codeGen() const override;
+      llvm::raw_ostream& dump(llvm::raw_ostream &out, int ind) const;
       
    private:
       double val_;
@@ -74,13 +93,12 @@ namespace AST {
    {
       
    public:
-      explicit VariableExprAST(code_generator::CodeGenerator& codeGenerator, const std::string& name );
-      const std::string& getName() const;
-      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) override;
-      llvm::Value* codeGen() const override;
+      explicit VariableExprAST(util::Symbol name);
+      util::Symbol getName() const;
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
    private:
-      std::string name_;
+      util::Symbol name_;
    };
    
    ///
@@ -88,26 +106,23 @@ namespace AST {
    ///
    class IfExprAST : public ExprAST
    {
-      using condion_t = std::unique_ptr<ExprAST>;
-      using then_branch_t = std::unique_ptr<ExprAST>;
-      using else_branch_t = std::unique_ptr<ExprAST>;
+      using condion_t = ExprAST*;
+      using then_branch_t = ExprAST*;
+      using else_branch_t = ExprAST*;
       
    public:
       
-      explicit IfExprAST(code_generator::CodeGenerator& codeGenerator,
-                         condion_t c,
+      explicit IfExprAST(condion_t c,
                          then_branch_t t,
                          else_branch_t e);
       
-      const condion_t& getCondion() const;
-      const then_branch_t& getThenBranch() const;
-      const else_branch_t& getElseBranch() const;
-      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) override;
-      
-      llvm::Value* codeGen() const override;
+      condion_t getCondion() const;
+      then_branch_t getThenBranch() const;
+      else_branch_t getElseBranch() const;
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
    private:
-      std::unique_ptr<ExprAST> cond_, then_, else_;
+      ExprAST *cond_, *then_, *else_;
       
    };
    
@@ -116,27 +131,24 @@ namespace AST {
    ///
    class ForExprAST : public ExprAST
    {
-      using expression_t = std::unique_ptr<ExprAST>;
+      using expression_t = ExprAST*;
       
    public:
-      explicit ForExprAST(code_generator::CodeGenerator& codeGenerator,
-                          std::string key,
+      explicit ForExprAST(util::Symbol key,
                           expression_t start,
                           expression_t end,
                           expression_t step,
                           expression_t body);
       
-      const std::string&  getKey() const;
-      const expression_t& getStart() const;
-      const expression_t& getEnd()   const;
-      const expression_t& getStep()  const;
-      const expression_t& getBody()  const;
-      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) override;
-      
-      llvm::Value* codeGen() const override;
+      util::Symbol getKey() const;
+      expression_t getStart() const;
+      expression_t getEnd()   const;
+      expression_t getStep()  const;
+      expression_t getBody()  const;
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
    private:
-      std::string key_;
+      util::Symbol key_;
       expression_t start_, end_, step_, body_;
    };
    
@@ -146,16 +158,14 @@ namespace AST {
    class UnaryExprAST : public ExprAST
    {
       using opcode_t = char;
-      using operand_t = std::unique_ptr<ExprAST>;
+      using operand_t = ExprAST*;
       
    public:
       
-      explicit UnaryExprAST(code_generator::CodeGenerator& codeGenerator, opcode_t opcode, operand_t operand);
+      explicit UnaryExprAST(opcode_t opcode, operand_t operand);
       opcode_t getOpcode() const;
-      const operand_t& getOperand() const;
-      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) override;
-      
-      llvm::Value *codeGen() const override;
+      operand_t getOperand() const;
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
    private:
       opcode_t opcode_;
@@ -168,16 +178,14 @@ namespace AST {
    class BinaryExprAST : public ExprAST
    {
       using opcode_t = unsigned char;
-      using operand_t = std::unique_ptr<ExprAST>;
+      using operand_t = ExprAST*;
       
    public:
-      explicit BinaryExprAST(code_generator::CodeGenerator& codesGenerator,
-                             opcode_t opcode, operand_t lhs, operand_t rhs);
+      explicit BinaryExprAST(opcode_t opcode, operand_t lhs, operand_t rhs);
       opcode_t getOpcode() const;
-      const operand_t& getLeftOperand() const;
-      const operand_t& getRightOperand() const;
-      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) override;
-      llvm::Value* codeGen() const override;
+      operand_t getLeftOperand() const;
+      operand_t getRightOperand() const;
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
    private:
       opcode_t opcode_;
@@ -190,16 +198,17 @@ namespace AST {
    ///
    class VarExprAST : public ExprAST
    {
-      using variable_names_t = std::vector<std::pair<std::string, std::unique_ptr<ExprAST>>>;
-      using expression_t = std::unique_ptr<ExprAST>;
+   public:
+      
+      using variable_t = std::pair<util::Symbol, ExprAST*>; //name, optional initializer
+      using variable_names_t = llvm::ArrayRef<variable_t>;
+      using expression_t = ExprAST*;
       
    public:
-      VarExprAST(code_generator::CodeGenerator& codesGenerator,
-                 variable_names_t varNames, expression_t body);
-      const variable_names_t& getVarNames() const;
-      const expression_t& getBody() const;
-      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) override;
-      llvm::Value *codeGen() const override;
+      VarExprAST(variable_names_t varNames, expression_t body);
+      variable_names_t getVarNames() const;
+      expression_t getBody() const;
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
    private:
       variable_names_t varNames_;
@@ -216,17 +225,17 @@ namespace AST {
    ///
    class CallExprAST : public ExprAST
    {
-      using Args = std::vector<std::unique_ptr<ExprAST>>;
-      
    public:
-      explicit CallExprAST(code_generator::CodeGenerator& codesGenerator, const std::string& callee, Args args);
-      const Args& getArgumentList() const;
-      const std::string getCallee() const;
-      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) override;
-      llvm::Value* codeGen() const override;
+      
+      using Args = llvm::ArrayRef<ExprAST*>;
+      
+      explicit CallExprAST(util::Symbol callee, Args args);
+      Args getArgumentList() const;
+      util::Symbol getCallee() const;
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
    private:
-      std::string callee_;
+      util::Symbol callee_;
       Args args_;
    };
    
@@ -235,26 +244,26 @@ namespace AST {
    ///
    class PrototypeAST : public ExprAST
    {
-      using Args = std::vector<std::string>;
-      
    public:
-      explicit PrototypeAST(code_generator::CodeGenerator& codesGenerator,
-                            std::string name,
+      
+      using Args = llvm::ArrayRef<util::Symbol>;
+      
+      explicit PrototypeAST(util::Symbol name,
                             Args args,
                             bool is_operator = false,
                             unsigned precedence = 0);
       
-      const Args& getArgumentList() const;
-      const std::string& getName() const;
+      Args getArgumentList() const;
+      util::Symbol getName() const;
+      bool isOperator() const;
       bool isUnary() const;
       bool isBinary() const;
       unsigned getBinaryPrecedence() const;
       char getOperatorName() const;
-      
-      llvm::Function* codeGen() const override;
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
    private:
-      std::string name_;
+      util::Symbol name_;
       Args args_;
       bool is_operator_;
       unsigned precedence_;
@@ -265,15 +274,14 @@ namespace AST {
    ///
    class FunctionAST : public ExprAST
    {
-      using prototype_t = std::unique_ptr<PrototypeAST>;
-      using body_t = std::unique_ptr<ExprAST>;
+      using prototype_t = PrototypeAST*;
+      using body_t = ExprAST*;
       
    public:
-      explicit FunctionAST(code_generator::CodeGenerator& codesGenerator, prototype_t prototype, body_t body);
-      const prototype_t& getPrototype() const;
-      const body_t& getBody() const;
-      llvm::Function* codeGen() const override;
-      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) override;
+      explicit FunctionAST(prototype_t prototype, body_t body);
+      prototype_t getPrototype() const;
+      body_t getBody() const;
+      llvm::raw_ostream &dump(llvm::raw_ostream &out, int ind) const;
       
       //void eval(llvm::Function* f); //add jit compilation for functions
       
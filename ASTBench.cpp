@@ -0,0 +1,177 @@
+//
+//  ASTBench.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 16/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+//  Pointer tree against flat AST: parses the same definitions through AST::TreeBuilder and
+//  through AST::FlatBuilder, then generates their IR, and reports for both the parse time, the
+//  memory of the nodes and the codegen time. The input is tokenized before the clock starts,
+//  the IR is neither optimized nor compiled. The two alternate for a number of passes, the best
+//  pass of each is reported: the first run of a process pays for the warm up of the heap.
+//
+//  usage: astbench.out [functions] [passes]   (default 100000 functions, 3 passes)
+//
+
+#include "ASTBuilder.h"
+#include "InputSource.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+#include "llvm/Support/TargetSelect.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+   using milliseconds_t = std::chrono::duration<double, std::milli>;
+
+   ///
+   /// @brief: definitions using every construct but for, each one calls an earlier one
+   ///
+   std::string generate(std::size_t functions)
+   {
+      std::string text;
+      for (std::size_t i = 0; i < functions; ++i)
+      {
+         text += "def f" + std::to_string(i) + "(x y) if x < y then f" + std::to_string(i / 2) +
+                 "(x + 1, y - 2) * 3 else var a = x * y, b = 0 - x in (a - b) * " +
+                 std::to_string(i % 97) + " + y;\n";
+      }
+      return text;
+   }
+
+   ///
+   /// what differs between the representations
+   ///
+
+   std::size_t getFootprint(const AST::ASTContext& context) { return context.getBytesAllocated(); }
+   std::size_t getFootprint(const AST::FlatAST& ast) { return ast.getMemoryFootprint(); }
+
+   llvm::Function* codeGen(code_generator::CodeGenerator& codeGenerator, const AST::ASTContext&, const AST::FunctionAST* function)
+   {
+      return codeGenerator.codeGenFunctionExpr(function);
+   }
+
+   llvm::Function* codeGen(code_generator::CodeGenerator& codeGenerator, const AST::FlatAST& ast, AST::NodeId function)
+   {
+      return codeGenerator.codeGenFunctionExpr(ast, function);
+   }
+
+   struct Result
+   {
+      double parse;      //ms
+      std::size_t bytes; //of the nodes
+      double codegen;    //ms
+   };
+
+   ///
+   /// @brief: parse the definitions of text in nodes, then generate them in a single module
+   ///
+   template <typename Builder, typename Nodes>
+   bool run(const std::string& text, std::size_t functions, Nodes& nodes, Result& result)
+   {
+      parser::Parser parser(std::make_unique<lexer::StringInputSource>(text));
+      parser.setTokenPrecedence('=', 2);
+      parser.setTokenPrecedence('<', 10);
+      parser.setTokenPrecedence('+', 20);
+      parser.setTokenPrecedence('-', 30);
+      parser.setTokenPrecedence('*', 40);
+      parser.setJit(false);
+      parser.setBatchMode(true); //optimized when the module is complete, which it never is here
+      parser.tokenizeInput();
+
+      Builder builder(nodes);
+      std::vector<typename Builder::function_t> parsed;
+      parsed.reserve(functions);
+
+      // every definition ends with ';', the token after it is the next 'def'
+      auto start = std::chrono::steady_clock::now();
+      for (int token = parser.getNextToken(); token == lexer::tok_def; token = parser.getNextToken())
+      {
+         auto function = parser.parseDefinition(builder);
+         if (Builder::isNull(function))
+            return false;
+         parsed.push_back(function);
+      }
+      milliseconds_t parse = std::chrono::steady_clock::now() - start;
+
+      auto& codeGenerator = parser.getCodeGenerator();
+      start = std::chrono::steady_clock::now();
+      for (auto function : parsed)
+      {
+         if (!codeGen(codeGenerator, nodes, function))
+            return false;
+      }
+      milliseconds_t codegen = std::chrono::steady_clock::now() - start;
+
+      result = Result{parse.count(), getFootprint(nodes), codegen.count()};
+      return parsed.size() == functions;
+   }
+
+   Result best(const Result& a, const Result& b)
+   {
+      return Result{std::min(a.parse, b.parse), a.bytes, std::min(a.codegen, b.codegen)};
+   }
+
+   void print(const char* name, const Result& result, std::size_t functions)
+   {
+      std::cout << name << ": parse " << result.parse << " ms, "
+                << "nodes " << result.bytes << " bytes (" << double(result.bytes) / functions << " per function), "
+                << "codegen " << result.codegen << " ms\n";
+   }
+}
+
+int main(int argc, const char* argv[])
+{
+   // the jit of the parsers needs the target, as in Driver::go()
+   llvm::InitializeNativeTarget();
+   llvm::InitializeNativeTargetAsmPrinter();
+
+   std::size_t functions = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+   if (functions == 0)
+      functions = 1;
+   int passes = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+
+   auto text = generate(functions);
+   std::cout << "input: " << functions << " functions, " << text.size() << " bytes\n";
+
+   Result tree, flat;
+
+   for (int pass = 0; pass < passes; ++pass)
+   {
+      Result treePass, flatPass;
+
+      AST::ASTContext context;
+      if (!run<AST::TreeBuilder>(text, functions, context, treePass))
+      {
+         std::cerr << "Error: the pointer tree run failed\n";
+         return 1;
+      }
+
+      AST::FlatAST ast;
+      if (!run<AST::FlatBuilder>(text, functions, ast, flatPass))
+      {
+         std::cerr << "Error: the flat AST run failed\n";
+         return 1;
+      }
+
+      tree = pass == 0 ? treePass : best(tree, treePass);
+      flat = pass == 0 ? flatPass : best(flat, flatPass);
+   }
+
+   print("tree", tree, functions);
+   print("flat", flat, functions);
+
+   std::cout << "flat/tree: parse " << flat.parse / tree.parse
+             << ", nodes " << double(flat.bytes) / tree.bytes
+             << ", codegen " << flat.codegen / tree.codegen << "\n";
+   return 0;
+}
@@ -0,0 +1,141 @@
+//
+//  ASTBuilder.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 16/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef ASTBuilder_h
+#define ASTBuilder_h
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include "AST.h"
+#include "ASTContext.h"
+#include "FlatAST.h"
+#include "Interner.h"
+
+namespace AST
+{
+
+   ///
+   /// @brief: node factories of the parser, one per representation of the AST. The parse functions
+   ///         are templates over them: the same grammar creates pointer nodes in an ASTContext or
+   ///         appends flat nodes to a FlatAST, with no copy in between.
+   ///         node_t is an expression, prototype_t and function_t the top level items, null() the
+   ///         missing node of any of them
+   ///
+
+   ///
+   /// @brief: pointer tree in an ASTContext
+   ///
+   class TreeBuilder
+   {
+   public:
+
+      using node_t = ExprAST*;
+      using prototype_t = PrototypeAST*;
+      using function_t = FunctionAST*;
+      using binding_t = VarExprAST::variable_t;
+
+      explicit TreeBuilder(ASTContext& context) : context_(context) {}
+
+      static std::nullptr_t null() { return nullptr; }
+      static bool isNull(const ExprAST* node) { return node == nullptr; }
+
+      node_t number(double value) { return context_.create<NumberExprAST>(value); }
+      node_t variable(util::Symbol name) { return context_.create<VariableExprAST>(name); }
+      node_t unary(char opcode, node_t operand) { return context_.create<UnaryExprAST>(opcode, operand); }
+
+      node_t binary(unsigned char opcode, node_t lhs, node_t rhs)
+      {
+         return context_.create<BinaryExprAST>(opcode, lhs, rhs);
+      }
+
+      node_t call(util::Symbol callee, llvm::ArrayRef<node_t> args)
+      {
+         return context_.create<CallExprAST>(callee, context_.copyArray(args));
+      }
+
+      node_t ifExpr(node_t condition, node_t thenBranch, node_t elseBranch)
+      {
+         return context_.create<IfExprAST>(condition, thenBranch, elseBranch);
+      }
+
+      node_t forExpr(util::Symbol key, node_t start, node_t end, node_t step, node_t body)
+      {
+         return context_.create<ForExprAST>(key, start, end, step, body);
+      }
+
+      node_t var(llvm::ArrayRef<binding_t> bindings, node_t body)
+      {
+         return context_.create<VarExprAST>(context_.copyArray(bindings), body);
+      }
+
+      prototype_t prototype(util::Symbol name, llvm::ArrayRef<util::Symbol> args, bool isOperator = false, unsigned precedence = 0)
+      {
+         return context_.create<PrototypeAST>(name, context_.copyArray(args), isOperator, precedence);
+      }
+
+      function_t function(prototype_t prototype, node_t body)
+      {
+         return context_.create<FunctionAST>(prototype, body);
+      }
+
+   private:
+
+      ASTContext& context_;
+   };
+
+   ///
+   /// @brief: flat nodes appended to a FlatAST. The parser creates children before their parent,
+   ///         as FlatAST requires
+   ///
+   class FlatBuilder
+   {
+   public:
+
+      using node_t = NodeId;
+      using prototype_t = NodeId;
+      using function_t = NodeId;
+      using binding_t = FlatAST::binding_t;
+
+      explicit FlatBuilder(FlatAST& ast) : ast_(ast) {}
+
+      static NodeId null() { return NoNode; }
+      static bool isNull(NodeId node) { return node == NoNode; }
+
+      node_t number(double value) { return ast_.addNumber(value); }
+      node_t variable(util::Symbol name) { return ast_.addVariable(name); }
+      node_t unary(char opcode, node_t operand) { return ast_.addUnary(opcode, operand); }
+      node_t binary(unsigned char opcode, node_t lhs, node_t rhs) { return ast_.addBinary(opcode, lhs, rhs); }
+      node_t call(util::Symbol callee, llvm::ArrayRef<node_t> args) { return ast_.addCall(callee, args); }
+
+      node_t ifExpr(node_t condition, node_t thenBranch, node_t elseBranch)
+      {
+         return ast_.addIf(condition, thenBranch, elseBranch);
+      }
+
+      node_t forExpr(util::Symbol key, node_t start, node_t end, node_t step, node_t body)
+      {
+         return ast_.addFor(key, start, end, step, body);
+      }
+
+      node_t var(llvm::ArrayRef<binding_t> bindings, node_t body) { return ast_.addVar(bindings, body); }
+
+      prototype_t prototype(util::Symbol name, llvm::ArrayRef<util::Symbol> args, bool isOperator = false, unsigned precedence = 0)
+      {
+         return ast_.addPrototype(name, args, isOperator, precedence);
+      }
+
+      function_t function(prototype_t prototype, node_t body) { return ast_.addFunction(prototype, body); }
+
+   private:
+
+      FlatAST& ast_;
+   };
+
+}
+
+#endif /* ASTBuilder_h */
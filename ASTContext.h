@@ -0,0 +1,85 @@
+//
+//  ASTContext.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef ASTContext_h
+#define ASTContext_h
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/Allocator.h"
+
+namespace AST
+{
+
+   ///
+   /// @brief: bump pointer arena backing the AST nodes of a compilation unit and their child arrays.
+   ///         Nodes own nothing and their destructors are never run: everything allocated is
+   ///         released in one shot by reset() (or when the context goes away), so no node or array
+   ///         may be used after that
+   ///
+   class ASTContext
+   {
+   public:
+
+      ASTContext() = default;
+
+      ASTContext(const ASTContext&) = delete;
+      ASTContext& operator=(const ASTContext&) = delete;
+
+      ///
+      /// @brief: construct a node in the arena
+      ///
+      template <typename T, typename... Args>
+      T* create(Args&&... args)
+      {
+         static_assert(std::is_trivially_destructible<T>::value, "AST nodes are never destroyed");
+         return new (allocator_.Allocate<T>()) T(std::forward<Args>(args)...);
+      }
+
+      ///
+      /// @brief: copy a child array in the arena
+      ///
+      template <typename T>
+      llvm::ArrayRef<T> copyArray(llvm::ArrayRef<T> elements)
+      {
+         static_assert(std::is_trivially_destructible<T>::value, "AST arrays are never destroyed");
+         if (elements.empty())
+            return llvm::ArrayRef<T>();
+
+         T* copy = allocator_.Allocate<T>(elements.size());
+         std::uninitialized_copy(elements.begin(), elements.end(), copy);
+         return llvm::ArrayRef<T>(copy, elements.size());
+      }
+
+      ///
+      /// @brief: free every node and array at once. The memory of the first slab is kept for the
+      ///         next unit
+      ///
+      void reset()
+      {
+         allocator_.Reset();
+      }
+
+      std::size_t getBytesAllocated() const
+      {
+         return allocator_.getBytesAllocated();
+      }
+
+   private:
+
+      llvm::BumpPtrAllocator allocator_;
+   };
+
+}
+
+#endif /* ASTContext_h */
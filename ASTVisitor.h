@@ -0,0 +1,74 @@
+//
+//  ASTVisitor.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef ASTVisitor_h
+#define ASTVisitor_h
+
+#include <utility>
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include "AST.h"
+
+namespace AST
+{
+
+   ///
+   /// @brief: static visitor over the AST. Derived implements one visitXxx(const XxxAST*, Args...)
+   ///         per node kind, visit() dispatches on the kind stored in the node, so there is a single
+   ///         switch and no virtual call per node:
+   ///
+   ///         class Printer : public ASTVisitor<Printer, void>
+   ///         {
+   ///            void visitNumberExpr(const NumberExprAST* node) { ... }
+   ///            ...
+   ///         };
+   ///
+   ///         Any extra argument passed to visit() is forwarded to the visitXxx method
+   ///
+   template <typename Derived, typename RetTy>
+   class ASTVisitor
+   {
+   public:
+
+      template <typename... Args>
+      RetTy visit(const ExprAST* node, Args&&... args)
+      {
+         auto& derived = static_cast<Derived&>(*this);
+
+         switch (node->getKind())
+         {
+            case ExprAST::NumberKind:
+               return derived.visitNumberExpr(static_cast<const NumberExprAST*>(node), std::forward<Args>(args)...);
+            case ExprAST::VariableKind:
+               return derived.visitVariableExpr(static_cast<const VariableExprAST*>(node), std::forward<Args>(args)...);
+            case ExprAST::UnaryKind:
+               return derived.visitUnaryExpr(static_cast<const UnaryExprAST*>(node), std::forward<Args>(args)...);
+            case ExprAST::BinaryKind:
+               return derived.visitBinaryExpr(static_cast<const BinaryExprAST*>(node), std::forward<Args>(args)...);
+            case ExprAST::CallKind:
+               return derived.visitCallExpr(static_cast<const CallExprAST*>(node), std::forward<Args>(args)...);
+            case ExprAST::IfKind:
+               return derived.visitIfExpr(static_cast<const IfExprAST*>(node), std::forward<Args>(args)...);
+            case ExprAST::ForKind:
+               return derived.visitForExpr(static_cast<const ForExprAST*>(node), std::forward<Args>(args)...);
+            case ExprAST::VarKind:
+               return derived.visitVarExpr(static_cast<const VarExprAST*>(node), std::forward<Args>(args)...);
+            case ExprAST::PrototypeKind:
+               return derived.visitPrototype(static_cast<const PrototypeAST*>(node), std::forward<Args>(args)...);
+            case ExprAST::FunctionKind:
+               return derived.visitFunction(static_cast<const FunctionAST*>(node), std::forward<Args>(args)...);
+         }
+
+         llvm_unreachable("unknown AST node kind");
+      }
+   };
+
+}
+
+#endif /* ASTVisitor_h */
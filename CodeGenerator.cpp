@@ -15,6 +15,7 @@
 
 #include "Parser.h"
 #include "AST.h"
+#include "ASTVisitor.h"
 #include "JIT.h"
 
 #include "llvm/ADT/STLExtras.h"
@@ -22,6 +23,9 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
 
 
 using llvm::Value;
@@ -33,14 +37,28 @@ using namespace AST;
 
 namespace code_generator
 {
+   namespace
+   {
+      ///
+      /// string attribute holding the precedence of a binary operator function
+      ///
+      const char* const PrecedenceAttribute = "kaleidoscope.precedence";
+   }
    
    ///
-   /// return a reference to the internal map that holds all the operators
+   /// @brief: precedence of a binary operator, -1 if the token is not one
    ///
    int CodeGeneratorImpl::getOperatorPrecedence(unsigned char token) const
    {
-      auto it = binaryOperationPrecedence_.find(token);
-      return it != binaryOperationPrecedence_.end() ? it->second : -1;
+      return binaryOperationPrecedence_.lookup(token);
+   }
+   
+   ///
+   /// @brief: return a reference to the table that holds all the operators
+   ///
+   const util::PrecedenceTable& CodeGeneratorImpl::getPrecedenceTable() const
+   {
+      return binaryOperationPrecedence_;
    }
    
    ///
@@ -56,93 +74,333 @@ namespace code_generator
    ///
    void CodeGeneratorImpl::setOperatorPrecedence(unsigned char token, int value)
    {
-      binaryOperationPrecedence_.insert(std::make_pair(token, value));
+      binaryOperationPrecedence_.set(token, value);
    }
    
    
-   void CodeGeneratorImpl::addProtypeCache(const std::string& key, std::unique_ptr<PrototypeAST>& prototype)
+   void CodeGeneratorImpl::addProtypeCache(util::Symbol key, const PrototypeAST* prototype)
+   {
+      cachePrototype(key, prototype->getArgumentList(), prototype->isOperator(), prototype->getBinaryPrecedence());
+   }
+   
+   void CodeGeneratorImpl::addProtypeCache(const FlatAST& ast, NodeId prototype)
    {
-      //mmm... hugly
-      prototypeCache_[key] = std::move(prototype);
+      cachePrototype(ast.prototypeName(prototype),
+                     ast.prototypeArgs(prototype),
+                     ast.prototypeIsOperator(prototype),
+                     ast.prototypePrecedence(prototype));
    }
    
+   void CodeGeneratorImpl::cachePrototype(util::Symbol name,
+                                          llvm::ArrayRef<util::Symbol> args,
+                                          bool isOperator,
+                                          unsigned precedence)
+   {
+      // top level expressions are never called, and each one has a name of its own
+      if (name.str().startswith("__anon_expr"))
+         return;
+      
+      // a function compiled again with the same signature keeps its node, prototypeContext_ only
+      // grows with the signatures that change
+      auto cached = prototypeCache_.find(name);
+      if (cached != prototypeCache_.end() &&
+          cached->second->getArgumentList() == args &&
+          cached->second->isOperator() == isOperator &&
+          cached->second->getBinaryPrecedence() == precedence)
+         return;
+      
+      prototypeCache_[name] = prototypeContext_.create<PrototypeAST>(name,
+                                                                     prototypeContext_.copyArray(args),
+                                                                     isOperator,
+                                                                     precedence);
+   }
+   
+   ///
+   /// @brief: every module has a context of its own, the jit compiles it on another thread while
+   ///         the next one is generated
+   ///
    void CodeGeneratorImpl::InitializeModuleAndPassManager()
    {
-      module_ = std::make_unique<llvm::Module>("hacking", context_);
-      optimizer_->enablePrematureOptimization(module_.get());
+      context_ = llvm::orc::ThreadSafeContext(std::make_unique<llvm::LLVMContext>());
+      builder_ = std::make_unique<llvm::IRBuilder<>>(getContext());
+      module_ = std::make_unique<llvm::Module>("hacking", getContext());
+      optimizer_->setTargetMachine(jitCompiler_.getTargetMachine());
 
       module_->setDataLayout(jitCompiler_.getTargetMachine().createDataLayout());
    }
 
+   llvm::orc::ThreadSafeModule CodeGeneratorImpl::loadModule(const std::string& path)
+   {
+      llvm::orc::ThreadSafeContext context(std::make_unique<llvm::LLVMContext>());
+      llvm::SMDiagnostic diagnostic;
+      auto module = llvm::parseIRFile(path, diagnostic, *context.getContext());
+      if (!module)
+      {
+         std::cerr << "Error: cannot load " << path << ": " << diagnostic.getMessage().str() << "\n";
+         return llvm::orc::ThreadSafeModule();
+      }
+      
+      if (llvm::verifyModule(*module, &llvm::errs()))
+      {
+         std::cerr << "Error: " << path << " is not a valid module\n";
+         return llvm::orc::ThreadSafeModule();
+      }
+      
+      module->setDataLayout(jitCompiler_.getTargetMachine().createDataLayout());
+      
+      for (auto& function : *module)
+      {
+         if (function.isDeclaration())
+            continue;
+         
+         // the top level expressions of the module are not run, nor seen by the modules to come
+         if (function.getName().startswith("__anon_expr"))
+         {
+            function.setLinkage(llvm::Function::InternalLinkage);
+            continue;
+         }
+         
+         llvm::SmallVector<util::Symbol, 8> args;
+         for (const auto& arg : function.args())
+            args.push_back(interner_.intern(arg.getName()));
+         
+         auto name = interner_.intern(function.getName());
+         bool isOperator = (function.getName().startswith("unary") && args.size() == 1) ||
+                           (function.getName().startswith("binary") && args.size() == 2);
+         
+         unsigned precedence = 0;
+         if (function.hasFnAttribute(PrecedenceAttribute))
+         {
+            function.getFnAttribute(PrecedenceAttribute).getValueAsString().getAsInteger(10, precedence);
+            binaryOperationPrecedence_.set(function.getName().back(), precedence);
+         }
+         
+         cachePrototype(name, args, isOperator, precedence);
+      }
+      
+      return llvm::orc::ThreadSafeModule(std::move(module), std::move(context));
+   }
+   
    ///
    /// ctor of the code generator
    ///
    
    //tmp hack to pass the jit compiler into the code generator2
-   CodeGeneratorImpl::CodeGeneratorImpl(jit::JIT& jitCompiler) : CodeGenerator(),
-      jitCompiler_(jitCompiler),
+   CodeGeneratorImpl::CodeGeneratorImpl(jit::JIT& jitCompiler, util::Interner& interner) : CodeGenerator(),
+      builder_(nullptr),
       module_(nullptr),
-      builder_(context_),
-      optimizer_(std::make_unique<optimizer::Optimizer>())
+      optimizer_(std::make_unique<optimizer::Optimizer>()),
+      jitCompiler_(jitCompiler),
+      interner_(interner)
    {
       //InitializeModuleAndPassManager();
    }
    
+   ///
+   /// @brief: the pointer tree seen through the same accessors of FlatAST, so that both
+   ///         representations share the emitters below
+   ///
+   struct CodeGeneratorImpl::TreeView
+   {
+      using node_t = const ExprAST*;
+      
+      ExprAST::Kind kind(node_t node) const { return node->getKind(); }
+      bool isNull(node_t node) const { return node == nullptr; }
+      
+      double number(node_t node) const { return as<NumberExprAST>(node)->getVal(); }
+      util::Symbol variableName(node_t node) const { return as<VariableExprAST>(node)->getName(); }
+      
+      char unaryOpcode(node_t node) const { return as<UnaryExprAST>(node)->getOpcode(); }
+      node_t unaryOperand(node_t node) const { return as<UnaryExprAST>(node)->getOperand(); }
+      
+      unsigned char binaryOpcode(node_t node) const { return as<BinaryExprAST>(node)->getOpcode(); }
+      node_t binaryLhs(node_t node) const { return as<BinaryExprAST>(node)->getLeftOperand(); }
+      node_t binaryRhs(node_t node) const { return as<BinaryExprAST>(node)->getRightOperand(); }
+      
+      util::Symbol callee(node_t node) const { return as<CallExprAST>(node)->getCallee(); }
+      CallExprAST::Args callArgs(node_t node) const { return as<CallExprAST>(node)->getArgumentList(); }
+      
+      node_t ifCondition(node_t node) const { return as<IfExprAST>(node)->getCondion(); }
+      node_t ifThen(node_t node) const { return as<IfExprAST>(node)->getThenBranch(); }
+      node_t ifElse(node_t node) const { return as<IfExprAST>(node)->getElseBranch(); }
+      
+      util::Symbol forKey(node_t node) const { return as<ForExprAST>(node)->getKey(); }
+      node_t forStart(node_t node) const { return as<ForExprAST>(node)->getStart(); }
+      node_t forEnd(node_t node) const { return as<ForExprAST>(node)->getEnd(); }
+      node_t forStep(node_t node) const { return as<ForExprAST>(node)->getStep(); }
+      node_t forBody(node_t node) const { return as<ForExprAST>(node)->getBody(); }
+      
+      VarExprAST::variable_names_t varBindings(node_t node) const { return as<VarExprAST>(node)->getVarNames(); }
+      node_t varBody(node_t node) const { return as<VarExprAST>(node)->getBody(); }
+      
+      util::Symbol prototypeName(node_t node) const { return as<PrototypeAST>(node)->getName(); }
+      PrototypeAST::Args prototypeArgs(node_t node) const { return as<PrototypeAST>(node)->getArgumentList(); }
+      bool prototypeIsOperator(node_t node) const { return as<PrototypeAST>(node)->isOperator(); }
+      unsigned prototypePrecedence(node_t node) const { return as<PrototypeAST>(node)->getBinaryPrecedence(); }
+      
+      node_t functionPrototype(node_t node) const { return as<FunctionAST>(node)->getPrototype(); }
+      node_t functionBody(node_t node) const { return as<FunctionAST>(node)->getBody(); }
+      
+   private:
+      
+      template <typename T>
+      static const T* as(node_t node) { return static_cast<const T*>(node); }
+   };
+   
+   Value* CodeGeneratorImpl::codeGen(const ExprAST* expression)
+   {
+      return lower(TreeView(), expression);
+   }
+   
+   Value* CodeGeneratorImpl::codeGen(const FlatAST& ast, NodeId expression)
+   {
+      return lower(ast, expression);
+   }
+   
    Value* CodeGeneratorImpl::errorV(const std::string& errorMsg) const
    {
       std::cerr << errorMsg << std::endl;
       return nullptr;
    }
    
+   ///
+   /// pointer tree entry points
+   ///
+   
    Value* CodeGeneratorImpl::codeGenNumberExpr(const NumberExprAST* numExpr)
    {
-      return llvm::ConstantFP::get(context_, llvm::APFloat(numExpr->getVal()));
+      return emitNumber(TreeView(), numExpr);
    }
    
    Value* CodeGeneratorImpl::codeGenVariableExpr(const VariableExprAST* variableExpr)
    {
-      auto v = namedValues_.find(variableExpr->getName());
+      return emitVariable(TreeView(), variableExpr);
+   }
+   
+   Value* CodeGeneratorImpl::codeGenUnaryExpr(const UnaryExprAST* unaryExpr)
+   {
+      return emitUnary(TreeView(), unaryExpr);
+   }
+   
+   Value* CodeGeneratorImpl::codeGenBinaryExpr(const BinaryExprAST* binaryExpr)
+   {
+      return emitBinary(TreeView(), binaryExpr);
+   }
+   
+   Value* CodeGeneratorImpl::codeGenCallExpr(const CallExprAST* callExpr)
+   {
+      return emitCall(TreeView(), callExpr);
+   }
+   
+   Value* CodeGeneratorImpl::codeGenIfExpr(const IfExprAST* ifExpr)
+   {
+      if(!ifExpr)
+         return nullptr;
+      
+      return emitIf(TreeView(), ifExpr);
+   }
+   
+   Value* CodeGeneratorImpl::codeGenForExpr(const ForExprAST* forExpr)
+   {
+      return emitFor(TreeView(), forExpr);
+   }
+   
+   Function* CodeGeneratorImpl::codeGenPrototypeExpr(const PrototypeAST* protoExpr)
+   {
+      return emitPrototype(TreeView(), protoExpr);
+   }
+   
+   Function* CodeGeneratorImpl::codeGenFunctionExpr(const FunctionAST* functExpr)
+   {
+      return emitFunction(TreeView(), functExpr);
+   }
+   
+   Value* CodeGeneratorImpl::codeGeneVarExpr(const VarExprAST* variableExpr)
+   {
+      return emitVar(TreeView(), variableExpr);
+   }
+   
+   ///
+   /// flat AST entry points
+   ///
+   
+   Function* CodeGeneratorImpl::codeGenPrototypeExpr(const FlatAST& ast, NodeId prototype)
+   {
+      return emitPrototype(ast, prototype);
+   }
+   
+   Function* CodeGeneratorImpl::codeGenFunctionExpr(const FlatAST& ast, NodeId function)
+   {
+      return emitFunction(ast, function);
+   }
+   
+   ///
+   /// emitters, shared by the two representations
+   ///
+   
+   Value* CodeGeneratorImpl::lower(const TreeView&, const ExprAST* node)
+   {
+      return ASTVisitor::visit(node);
+   }
+   
+   Value* CodeGeneratorImpl::lower(const FlatAST& ast, NodeId node)
+   {
+      return FlatASTVisitor::visit(ast, node);
+   }
+   
+   template <typename Tree>
+   Value* CodeGeneratorImpl::emitNumber(const Tree& tree, typename Tree::node_t node)
+   {
+      return llvm::ConstantFP::get(getContext(), llvm::APFloat(tree.number(node)));
+   }
+   
+   template <typename Tree>
+   Value* CodeGeneratorImpl::emitVariable(const Tree& tree, typename Tree::node_t node)
+   {
+      auto name = tree.variableName(node);
+      auto v = namedValues_.find(name);
       if( v == namedValues_.end() )
       {
-         return errorV( std::string("Unknown variable name : ") + variableExpr->getName());
+         return errorV( std::string("Unknown variable name : ") + name.str().str());
       }
       
-      return builder_.CreateLoad(v->second, variableExpr->getName());
-      return v->second;
+      return builder_->CreateLoad(v->second->getAllocatedType(), v->second, name.str());
    }
    
-   Value* CodeGeneratorImpl::codeGenUnaryExpr(const UnaryExprAST* unaryExpr)
+   template <typename Tree>
+   Value* CodeGeneratorImpl::emitUnary(const Tree& tree, typename Tree::node_t node)
    {
-      auto operandValue = unaryExpr->getOperand()->codeGen();
+      auto operandValue = lower(tree, tree.unaryOperand(node));
       if (!operandValue)
          return nullptr;
       
-      auto functionValue = getFunction(std::string("unary") +  unaryExpr->getOpcode());
+      auto functionValue = getFunction(interner_.intern(std::string("unary") + tree.unaryOpcode(node)));
       if (!functionValue)
          return errorV("Unknown unary operator");
       
-      return builder_.CreateCall(functionValue, operandValue, "unop");
+      return builder_->CreateCall(functionValue, operandValue, "unop");
    }
 
-   Value* CodeGeneratorImpl::codeGenBinaryExpr(const BinaryExprAST* binaryExpr)
-   { auto op = binaryExpr->getOpcode();
+   template <typename Tree>
+   Value* CodeGeneratorImpl::emitBinary(const Tree& tree, typename Tree::node_t node)
+   { auto op = tree.binaryOpcode(node);
 
       if( op == '=')
       {
-         return manageAssignment(binaryExpr);
+         return emitAssignment(tree, node);
       }
       else
       {
-         const auto& lhs = binaryExpr->getLeftOperand();
-         const auto& rhs = binaryExpr->getRightOperand();
+         auto lhs = tree.binaryLhs(node);
+         auto rhs = tree.binaryRhs(node);
          
-         if( lhs == nullptr || rhs == nullptr )
+         if( tree.isNull(lhs) || tree.isNull(rhs) )
             return nullptr;
 
          
          //evaluete operands
-         auto leftValue  = lhs->codeGen();
-         auto rightValue = rhs->codeGen();
+         auto leftValue  = lower(tree, lhs);
+         auto rightValue = lower(tree, rhs);
          
          if(leftValue == nullptr || rightValue == nullptr)
             return nullptr;
@@ -150,183 +408,183 @@ namespace code_generator
          switch (op)
          {
             case '+':
-               return builder_.CreateFAdd(leftValue, rightValue, "addtmp");
+               return builder_->CreateFAdd(leftValue, rightValue, "addtmp");
             case '-':
-               return builder_.CreateFSub(leftValue, rightValue, "subtmp");
+               return builder_->CreateFSub(leftValue, rightValue, "subtmp");
             case '*':
-               return builder_.CreateFMul(leftValue, rightValue, "multmp");
+               return builder_->CreateFMul(leftValue, rightValue, "multmp");
             case '<':
-               leftValue = builder_.CreateFCmpULT(leftValue, rightValue, "cmptmp");
+               leftValue = builder_->CreateFCmpULT(leftValue, rightValue, "cmptmp");
                // Convert bool to double
-               return builder_.CreateUIToFP(leftValue,
-                                            llvm::Type::getDoubleTy(context_),
+               return builder_->CreateUIToFP(leftValue,
+                                            llvm::Type::getDoubleTy(getContext()),
                                             "booltmp");
             default:
                break;
          }
          
-         auto function = getFunction(std::string("binary") + (char)op);
+         auto function = getFunction(interner_.intern(std::string("binary") + (char)op));
          assert(function != nullptr && "binary function not found");
          
          Value* ops[] = {leftValue, rightValue};
-         return builder_.CreateCall(function, ops, "binop");
+         return builder_->CreateCall(function, ops, "binop");
       }
       
      
    }
    
-   Value* CodeGeneratorImpl::codeGenCallExpr(const CallExprAST* callExpr)
+   template <typename Tree>
+   Value* CodeGeneratorImpl::emitCall(const Tree& tree, typename Tree::node_t node)
    {
-      Function* function = getFunction(callExpr->getCallee());
+      Function* function = getFunction(tree.callee(node));
       if( function == nullptr ) {
          errorV("Unknown function referenced");
          return nullptr;
       }
       
-      const auto& args = callExpr->getArgumentList();
+      auto args = tree.callArgs(node);
       if( function->arg_size() != args.size())
          errorV("Incorrect number of parameters passed");
       
       std::vector<Value*> argsV; //list of arguments evalueted
-      for( const auto& arg : args ) {
-         argsV.push_back(arg->codeGen());
-         if( args.back() == nullptr )
+      for( auto arg : args ) {
+         argsV.push_back(lower(tree, arg));
+         if( argsV.back() == nullptr )
             return nullptr;
       }
       
-      return builder_.CreateCall(function, argsV, "calltmp");
+      return builder_->CreateCall(function, argsV, "calltmp");
    }
    
-   Value* CodeGeneratorImpl::codeGenIfExpr(const IfExprAST* ifExpr)
+   template <typename Tree>
+   Value* CodeGeneratorImpl::emitIf(const Tree& tree, typename Tree::node_t node)
    {
-      if(!ifExpr)
-         return nullptr;
-      
       //resolve cond
-      auto CondV = ifExpr->getCondion()->codeGen();
+      auto CondV = lower(tree, tree.ifCondition(node));
       if (!CondV)
          return nullptr;
       
       // convert to bool comparing false to 0.0 (only doubles are supported)
-      CondV = builder_.CreateFCmpONE(CondV,
-                                     llvm::ConstantFP::get(context_,
+      CondV = builder_->CreateFCmpONE(CondV,
+                                     llvm::ConstantFP::get(getContext(),
                                                            llvm::APFloat(0.0)), "ifcond");
       
-      auto TheFunction = builder_.GetInsertBlock()->getParent();
+      auto TheFunction = builder_->GetInsertBlock()->getParent();
       
       // Create blocks for the then and else cases.
-      auto ThenBB = llvm::BasicBlock::Create(context_, "then", TheFunction);
-      auto ElseBB = llvm::BasicBlock::Create(context_, "else");
-      auto MergeBB = llvm::BasicBlock::Create(context_, "ifcont");
-      builder_.CreateCondBr(CondV, ThenBB, ElseBB);
+      auto ThenBB = llvm::BasicBlock::Create(getContext(), "then", TheFunction);
+      auto ElseBB = llvm::BasicBlock::Create(getContext(), "else");
+      auto MergeBB = llvm::BasicBlock::Create(getContext(), "ifcont");
+      builder_->CreateCondBr(CondV, ThenBB, ElseBB);
       
       // Emit then value.
-      builder_.SetInsertPoint(ThenBB);
+      builder_->SetInsertPoint(ThenBB);
       
       //resolve 'then' branch
-      auto ThenV = ifExpr->getThenBranch()->codeGen();
+      auto ThenV = lower(tree, tree.ifThen(node));
       if (!ThenV)
          return nullptr;
       
-      builder_.CreateBr(MergeBB);
+      builder_->CreateBr(MergeBB);
       // Codegen of 'Then' can change the current block, update ThenBB for the PHI.
-      ThenBB = builder_.GetInsertBlock();
+      ThenBB = builder_->GetInsertBlock();
       
       // Emit else block.
       TheFunction->getBasicBlockList().push_back(ElseBB);
-      builder_.SetInsertPoint(ElseBB);
+      builder_->SetInsertPoint(ElseBB);
       
-      auto ElseV = ifExpr->getElseBranch()->codeGen();
+      auto ElseV = lower(tree, tree.ifElse(node));
       if (!ElseV)
          return nullptr;
       
-      builder_.CreateBr(MergeBB);
+      builder_->CreateBr(MergeBB);
       // Codegen of 'Else' can change the current block, update ElseBB for the PHI.
-      ElseBB = builder_.GetInsertBlock();
+      ElseBB = builder_->GetInsertBlock();
       
       // Emit merge block.
       TheFunction->getBasicBlockList().push_back(MergeBB);
-      builder_.SetInsertPoint(MergeBB);
+      builder_->SetInsertPoint(MergeBB);
       
-      llvm::PHINode *PN = builder_.CreatePHI(llvm::Type::getDoubleTy(context_), 2, "iftmp");
+      llvm::PHINode *PN = builder_->CreatePHI(llvm::Type::getDoubleTy(getContext()), 2, "iftmp");
       PN->addIncoming(ThenV, ThenBB);
       PN->addIncoming(ElseV, ElseBB);
       return PN;
       
    }
    
-   Value* CodeGeneratorImpl::codeGenForExpr(const ForExprAST* forExpr)
+   template <typename Tree>
+   Value* CodeGeneratorImpl::emitFor(const Tree& tree, typename Tree::node_t node)
    {
-      auto StartVal = forExpr->getStart()->codeGen();
+      auto StartVal = lower(tree, tree.forStart(node));
       if (!StartVal)
          return nullptr;
       
       // Make the new basic block for the loop header, inserting after current
       // block.
-      auto TheFunction = builder_.GetInsertBlock()->getParent();
-      auto PreheaderBB = builder_.GetInsertBlock();
-      auto LoopBB = llvm::BasicBlock::Create(context_, "loop", TheFunction);
+      auto TheFunction = builder_->GetInsertBlock()->getParent();
+      auto PreheaderBB = builder_->GetInsertBlock();
+      auto LoopBB = llvm::BasicBlock::Create(getContext(), "loop", TheFunction);
       
       // Insert an explicit fall through from the current block to the LoopBB.
-      builder_.CreateBr(LoopBB);
+      builder_->CreateBr(LoopBB);
       
       // Start insertion in LoopBB.
-      builder_.SetInsertPoint(LoopBB);
+      builder_->SetInsertPoint(LoopBB);
       
       // Start the PHI node with an entry for Start.
-      auto Variable = builder_.CreatePHI(llvm::Type::getDoubleTy(context_),
-                                            2, forExpr->getKey().c_str());
+      auto varName = tree.forKey(node);
+      auto Variable = builder_->CreatePHI(llvm::Type::getDoubleTy(getContext()),
+                                            2, varName.str());
       
       Variable->addIncoming(StartVal, PreheaderBB);
       
       // Within the loop, the variable is defined equal to the PHI node.  If it
       // shadows an existing variable, we have to restore it, so save it now.
-      const auto& varName = forExpr->getKey();
       auto OldVal = namedValues_[varName];
-      namedValues_[varName] = CreateEntryBlockAlloca(TheFunction, varName);
+      namedValues_[varName] = CreateEntryBlockAlloca(TheFunction, varName.str());
       
       // Emit the body of the loop.  This, like any other expr, can change the
       // current BB.  Note that we ignore the value computed by the body, but don't
       // allow an error.
-      if (!forExpr->getBody()->codeGen())
+      if (!lower(tree, tree.forBody(node)))
          return nullptr;
       
       // Emit the step value.
-      const auto& Step = forExpr->getStep();
+      auto Step = tree.forStep(node);
       llvm::Value* StepVal = nullptr;
-      if (Step)
+      if (!tree.isNull(Step))
       {
-         StepVal = Step->codeGen();
+         StepVal = lower(tree, Step);
          if (!StepVal)
             return nullptr;
       }
       else
       {
          // If not specified, use 1.0.
-         StepVal = llvm::ConstantFP::get(context_, llvm::APFloat(1.0));
+         StepVal = llvm::ConstantFP::get(getContext(), llvm::APFloat(1.0));
       }
       
-      auto NextVar = builder_.CreateFAdd(Variable, StepVal, "nextvar");
+      auto NextVar = builder_->CreateFAdd(Variable, StepVal, "nextvar");
       
       // Compute the end condition.
-      auto EndCond = forExpr->getEnd()->codeGen();
+      auto EndCond = lower(tree, tree.forEnd(node));
       if (!EndCond)
          return nullptr;
       
       // Convert condition to a bool by comparing equal to 0.0.
-      EndCond = builder_.CreateFCmpONE(EndCond,
-                                       llvm::ConstantFP::get(context_,
+      EndCond = builder_->CreateFCmpONE(EndCond,
+                                       llvm::ConstantFP::get(getContext(),
                                                              llvm::APFloat(0.0)), "loopcond");
       
       // Create the "after loop" block and insert it.
-      auto LoopEndBB = builder_.GetInsertBlock();
-      auto AfterBB = llvm::BasicBlock::Create(context_, "afterloop", TheFunction);
+      auto LoopEndBB = builder_->GetInsertBlock();
+      auto AfterBB = llvm::BasicBlock::Create(getContext(), "afterloop", TheFunction);
       
       // Insert the conditional branch into the end of LoopEndBB.
-      builder_.CreateCondBr(EndCond, LoopBB, AfterBB);
+      builder_->CreateCondBr(EndCond, LoopBB, AfterBB);
       
       // Any new code will be inserted in AfterBB.
-      builder_.SetInsertPoint(AfterBB);
+      builder_->SetInsertPoint(AfterBB);
       
       // Add a new entry to the PHI node for the backedge.
       Variable->addIncoming(NextVar, LoopEndBB);
@@ -338,70 +596,86 @@ namespace code_generator
          namedValues_.erase(varName);
       
       // for expr always returns 0.0.
-      return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(context_));
+      return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(getContext()));
    }
 
 
-   Function* CodeGeneratorImpl::codeGenPrototypeExpr(const PrototypeAST* protoExpr)
+   template <typename Tree>
+   Function* CodeGeneratorImpl::emitPrototype(const Tree& tree, typename Tree::node_t node)
    {
-      auto argList = protoExpr->getArgumentList();
+      auto argList = tree.prototypeArgs(node);
       
       std::vector<llvm::Type*> args { argList.size(),
-         llvm::Type::getDoubleTy(context_)};
+         llvm::Type::getDoubleTy(getContext())};
       
-      llvm::FunctionType* functionType = llvm::FunctionType::get(llvm::Type::getDoubleTy(context_),
+      llvm::FunctionType* functionType = llvm::FunctionType::get(llvm::Type::getDoubleTy(getContext()),
                                                                  args,
                                                                  false);
       llvm::Function* f = llvm::Function::Create(functionType,
                                                  llvm::Function::ExternalLinkage,
-                                                 protoExpr->getName(),
+                                                 tree.prototypeName(node).str(),
                                                  module_.get());
       unsigned i = 0;
       for(auto& arg: f->args())
-         arg.setName(argList[i++]);
+         arg.setName(argList[i++].str());
       
       return f;
    }
    
-   Function* CodeGeneratorImpl::codeGenFunctionExpr(const FunctionAST* functExpr)
+   template <typename Tree>
+   Function* CodeGeneratorImpl::emitFunction(const Tree& tree, typename Tree::node_t node)
    {
-      const auto& prototype = functExpr->getPrototype();
-      const auto& body = functExpr->getBody();
+      auto prototype = tree.functionPrototype(node);
+      auto body = tree.functionBody(node);
+      auto name = tree.prototypeName(prototype);
+      auto argNames = tree.prototypeArgs(prototype);
+      bool isOperator = tree.prototypeIsOperator(prototype);
       
       //search for function declared by previous 'extern'
-      auto name = prototype->getName();
-      llvm::Function* f = getFunction(prototype->getName());
+      llvm::Function* f = getFunction(name);
       
       if( f == nullptr )
-         f = prototype->codeGen();
+         f = emitPrototype(tree, prototype);
       
-      if(prototype->isBinary())
-         binaryOperationPrecedence_[prototype->getOperatorName()] = prototype->getBinaryPrecedence();
+      //a module gathering many definitions can already hold this one
+      if( !f->empty() )
+      {
+         errorV("Function cannot be redefined");
+         return nullptr;
+      }
       
-      llvm::BasicBlock* bb = llvm::BasicBlock::Create(context_, "entry", f);
-      builder_.SetInsertPoint(bb);
+      if(isOperator && argNames.size() == 2)
+      {
+         binaryOperationPrecedence_.set(name.str().back(), tree.prototypePrecedence(prototype));
+         
+         // the precedence travels with the function, a module loaded back restores it
+         f->addFnAttr(PrecedenceAttribute, std::to_string(tree.prototypePrecedence(prototype)));
+      }
+      
+      llvm::BasicBlock* bb = llvm::BasicBlock::Create(getContext(), "entry", f);
+      builder_->SetInsertPoint(bb);
       namedValues_.clear();
+      unsigned i = 0;
       for( auto& arg : f->args())
       {
+         if (i == argNames.size())
+            break;
+         
          AllocaInst *alloca = CreateEntryBlockAlloca(f, arg.getName());
-         builder_.CreateStore(&arg, alloca);
-         namedValues_[arg.getName()] = alloca;
+         builder_->CreateStore(&arg, alloca);
+         namedValues_[argNames[i++]] = alloca;
       }
 
-      auto returnValue = body->codeGen();
+      auto returnValue = lower(tree, body);
       
-      //incredible hack to move in the ptr!!! work this out in some way that's better
-      auto& p = const_cast<std::unique_ptr<PrototypeAST>&>(prototype);
-      std::unique_ptr<PrototypeAST> ptr;
-      ptr.reset(p.release());
-      prototypeCache_[ptr->getName()] = std::move(ptr);
+      cachePrototype(name, argNames, isOperator, tree.prototypePrecedence(prototype));
       
       if(returnValue != nullptr)
       {
-         builder_.CreateRet(returnValue);
+         builder_->CreateRet(returnValue);
          if(!llvm::verifyFunction(*f)) {
-            //eager optimization peephole
-            optimizer_->runLocalFunctionOptimization(f);
+            //eager optimization peephole, if the policy says so
+            optimizer_->optimizeFunction(*f);
          }
          return f;
       }
@@ -411,33 +685,34 @@ namespace code_generator
       return nullptr;
    }
    
-   Value* CodeGeneratorImpl::codeGeneVarExpr(const VarExprAST* variableExpr)
+   template <typename Tree>
+   Value* CodeGeneratorImpl::emitVar(const Tree& tree, typename Tree::node_t node)
    {
       std::vector<AllocaInst *> oldBindings;
-      Function *function = builder_.GetInsertBlock()->getParent();
+      Function *function = builder_->GetInsertBlock()->getParent();
       
-      const auto& variableNames = variableExpr->getVarNames();
+      auto variableNames = tree.varBindings(node);
       
       for (unsigned i = 0, e = variableNames.size(); i != e; ++i)
       {
-         const auto& varName = variableNames[i].first;
-         const auto& init = variableNames[i].second;
+         auto varName = variableNames[i].first;
+         auto init = variableNames[i].second;
          
          //emit init
          Value *initVal;
-         if (init)
+         if (!tree.isNull(init))
          {
-            initVal = init->codeGen();
+            initVal = lower(tree, init);
             if (!initVal)
                return nullptr;
          }
          else
          {
-            initVal = llvm::ConstantFP::get(context_, llvm::APFloat(0.0));
+            initVal = llvm::ConstantFP::get(getContext(), llvm::APFloat(0.0));
          }
          
-         auto alloca = CreateEntryBlockAlloca(function, varName);
-         builder_.CreateStore(initVal, alloca);
+         auto alloca = CreateEntryBlockAlloca(function, varName.str());
+         builder_->CreateStore(initVal, alloca);
          
          //memorize bind
          oldBindings.push_back(namedValues_[varName]);
@@ -447,7 +722,7 @@ namespace code_generator
       }
       
       // Codegen the body, now that all vars are in scope.
-      auto bodyVal = variableExpr->getBody()->codeGen();
+      auto bodyVal = lower(tree, tree.varBody(node));
       if (!bodyVal)
          return nullptr;
       
@@ -459,8 +734,35 @@ namespace code_generator
       return bodyVal;
 
    }
-
    
+   ///
+   /// @brief: manage assigment
+   ///
+   template <typename Tree>
+   Value* CodeGeneratorImpl::emitAssignment(const Tree& tree, typename Tree::node_t node)
+   {
+      auto lhs = tree.binaryLhs(node);
+      auto rhs = tree.binaryRhs(node);
+      
+      if (tree.isNull(lhs) || tree.kind(lhs) != ExprAST::VariableKind)
+         return errorV("destination of '=' must be a variable");
+      
+      if(tree.isNull(rhs))
+         return errorV("expression to evaluate to the right of '=' must be valid");
+      
+      auto value = lower(tree, rhs);
+      if (!value)
+         return nullptr;
+      
+      // Look-up the name.
+      auto variable = namedValues_[tree.variableName(lhs)];
+      if (!variable)
+         return errorV("Unknown variable name");
+      
+      builder_->CreateStore(value, variable);
+      return value;
+   }
+
 
    ///
    /// Jit compilation test
@@ -478,54 +780,26 @@ namespace code_generator
    /// private interface
    ///
    
-   AllocaInst* CodeGeneratorImpl::CreateEntryBlockAlloca(Function *function, const std::string &variableName)
+   AllocaInst* CodeGeneratorImpl::CreateEntryBlockAlloca(Function *function, llvm::StringRef variableName)
    {
       llvm::IRBuilder<> TmpB(&function->getEntryBlock(), function->getEntryBlock().begin());
-      return TmpB.CreateAlloca(llvm::Type::getDoubleTy(context_), 0, variableName.c_str());
+      return TmpB.CreateAlloca(llvm::Type::getDoubleTy(getContext()), 0, variableName);
    }
    
    ///
    ///
    ///
-   Function* CodeGeneratorImpl::getFunction(const std::string& name) const
+   Function* CodeGeneratorImpl::getFunction(util::Symbol name)
    {
-      if( auto f = module_->getFunction(name) )
+      if( auto f = module_->getFunction(name.str()) )
          return f;
       
       auto fi = prototypeCache_.find(name);
       if ( fi != prototypeCache_.end())
-         return fi->second->codeGen();
+         return codeGenPrototypeExpr(fi->second);
       
       return nullptr;
    }
 
-   
-   ///
-   /// @brief: manage assigment
-   ///
-   llvm::Value* CodeGeneratorImpl::manageAssignment(const BinaryExprAST* binaryExpression)
-   {
-      using variable_expression_t = const std::unique_ptr<VariableExprAST>&;
-      //bit hacky here...
-      const auto& lhs = reinterpret_cast<variable_expression_t>(binaryExpression->getLeftOperand());
-      const auto& rhs = binaryExpression->getRightOperand();
-      
-      if (!lhs)
-         return errorV("destination of '=' must be a variable");
-      
-      if(!rhs)
-         return errorV("expression to evaluate to the right of '=' must be valid");
-      
-      auto value = rhs->codeGen();
-      if (!value)
-         return nullptr;
-      
-      // Look-up the name.
-      auto variable = namedValues_[lhs->getName()];
-      if (!variable)
-         return errorV("Unknown variable name");
-      
-      builder_.CreateStore(value, variable);
-      return value;
-   }
+
 }
@@ -17,7 +17,13 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 #include "Optimizer.h"
+#include "Interner.h"
+#include "PrecedenceTable.h"
+#include "ASTContext.h"
+#include "ASTVisitor.h"
+#include "FlatAST.h"
 
 
 namespace llvm
@@ -27,20 +33,6 @@ namespace llvm
    class AllocaInst; //to support mutable variable
 }
 
-namespace AST
-{
-   class NumberExprAST;
-   class VariableExprAST;
-   class UnaryExprAST;
-   class BinaryExprAST;
-   class CallExprAST;
-   class PrototypeAST;
-   class FunctionAST;
-   class IfExprAST;
-   class ForExprAST;
-   class VarExprAST;
-};
-
 namespace parser
 {
    class Parser;
@@ -58,8 +50,7 @@ using llvm::AllocaInst;
 
 namespace code_generator
 {
-   using precedence_tree_t = std::map<unsigned char, int>;
-   using prototype_cache_t = std::unordered_map<std::string, std::unique_ptr<PrototypeAST>>;
+   using prototype_cache_t = std::unordered_map<util::Symbol, const PrototypeAST*>;
    
    ///
    /// @brief: custom exception thrown by code generator
@@ -80,9 +71,8 @@ namespace code_generator
    
    ///
    /// @brief: main interface of the code generator object
-   ///         that emits the IR for the AST node passed to it
-   ///         This interface must be extended in order to implement
-   ///         a visitor pattern
+   ///         that emits the IR for the AST node passed to it.
+   ///         The AST does not know the generator, codeGen() dispatches on the kind of the node
    ///
    class CodeGenerator
    {
@@ -91,6 +81,19 @@ namespace code_generator
       //IR generation
       
       virtual ~CodeGenerator() = default;
+      
+      ///
+      /// @brief: emit the IR of any expression node
+      ///
+      virtual Value* codeGen(const ExprAST*) = 0;
+      
+      ///
+      /// @brief: emit the IR of a node of a flat AST
+      ///
+      virtual Value* codeGen(const AST::FlatAST&, AST::NodeId) = 0;
+      virtual Function* codeGenPrototypeExpr(const AST::FlatAST&, AST::NodeId) = 0;
+      virtual Function* codeGenFunctionExpr(const AST::FlatAST&, AST::NodeId) = 0;
+      
       virtual Value* errorV(const std::string&) const = 0;
       virtual Value* codeGenNumberExpr(const NumberExprAST*) = 0;
       virtual Value* codeGenVariableExpr(const VariableExprAST*) = 0;
@@ -108,30 +111,69 @@ namespace code_generator
       //adding new symbols and/or process new prototypes
       
       virtual int getOperatorPrecedence(unsigned char token) const = 0;
+      
+      ///
+      /// @brief: precedences of the binary operators of this session, updated by the definition of
+      ///         new operators. Parsers keep a reference and look it up without a virtual call
+      ///
+      virtual const util::PrecedenceTable& getPrecedenceTable() const = 0;
       virtual const prototype_cache_t& getProtypeCache() const = 0;
       
       virtual void setOperatorPrecedence(unsigned char token, int value) = 0;
-      virtual void addProtypeCache(const std::string& key, std::unique_ptr<PrototypeAST>& prototype) = 0;
       
-      //virtual hack to get the module
-      virtual void getModule(std::unique_ptr<llvm::Module>& module) = 0;
+      ///
+      /// @brief: remember a prototype for the modules to come. The prototype is copied, the AST it
+      ///         belongs to can be released afterwards
+      ///
+      virtual void addProtypeCache(util::Symbol key, const PrototypeAST* prototype) = 0;
+      virtual void addProtypeCache(const AST::FlatAST& ast, AST::NodeId prototype) = 0;
+      
+      ///
+      /// @brief: the optimizer of the session, functions generated go through its optimizeFunction()
+      ///
+      virtual optimizer::Optimizer& getOptimizer() = 0;
+      
+      ///
+      /// @brief: read a module (bitcode or textual IR) written by a previous compilation. Its
+      ///         functions become visible to the modules to come, with the precedence of the
+      ///         operators it defines. Returns an empty module (error reported) if it cannot
+      ///
+      virtual llvm::orc::ThreadSafeModule loadModule(const std::string& path) = 0;
+      
+      //virtual hack to get the module, with the context it lives in
+      virtual void getModule(llvm::orc::ThreadSafeModule& module) = 0;
       //hack to initialize the module and pass manager
       virtual void InitializeModuleAndPassManager() = 0;
       
    };
    
    ///
-   /// @brief: concrete implementation for the code generator
+   /// @brief: concrete implementation for the code generator.
+   ///         Children are lowered through the static visitors: the class is final, so the
+   ///         recursion never goes through a virtual call.
+   ///         Both the pointer tree and the flat AST are lowered by the same emitXxx templates,
+   ///         the tree through TreeView which exposes the accessors of FlatAST
    ///
    
-   class CodeGeneratorImpl : public CodeGenerator
+   class CodeGeneratorImpl final : public CodeGenerator,
+                                   private AST::ASTVisitor<CodeGeneratorImpl, Value*>,
+                                   private AST::FlatASTVisitor<CodeGeneratorImpl, Value*>
    {
+      friend class AST::ASTVisitor<CodeGeneratorImpl, Value*>;
+      friend class AST::FlatASTVisitor<CodeGeneratorImpl, Value*>;
+      
+      struct TreeView;
+      
    public:
     
-      explicit CodeGeneratorImpl(jit::JIT& jitCompiler);
+      explicit CodeGeneratorImpl(jit::JIT& jitCompiler, util::Interner& interner);
 
       //concrete impleentation for generatring IR
       
+      virtual Value* codeGen(const ExprAST*) override;
+      virtual Value* codeGen(const AST::FlatAST&, AST::NodeId) override;
+      virtual Function* codeGenPrototypeExpr(const AST::FlatAST&, AST::NodeId) override;
+      virtual Function* codeGenFunctionExpr(const AST::FlatAST&, AST::NodeId) override;
       virtual Value* errorV(const std::string&) const override;
       virtual Value* codeGenNumberExpr(const NumberExprAST*) override;
       virtual Value* codeGenVariableExpr(const VariableExprAST*) override;
@@ -142,54 +184,119 @@ namespace code_generator
       virtual Value* codeGenForExpr(const ForExprAST*) override;
       virtual Function* codeGenPrototypeExpr(const PrototypeAST*) override;
       virtual Function* codeGenFunctionExpr(const FunctionAST*) override;
+      
+      using CodeGenerator::codeGenPrototypeExpr;
+      using CodeGenerator::codeGenFunctionExpr;
       virtual Value* codeGeneVarExpr(const VarExprAST*) override;
 
    public:
       
       //concrete implementation for adding new prototypes/symbols
       virtual int getOperatorPrecedence(unsigned char token) const override;
+      virtual const util::PrecedenceTable& getPrecedenceTable() const override;
       virtual const prototype_cache_t& getProtypeCache() const override;
       virtual void setOperatorPrecedence(unsigned char token, int value) override;
-      virtual void addProtypeCache(const std::string& key, std::unique_ptr<PrototypeAST>& prototype) override;
+      virtual void addProtypeCache(util::Symbol key, const PrototypeAST* prototype) override;
+      virtual void addProtypeCache(const AST::FlatAST& ast, AST::NodeId prototype) override;
 
+      virtual optimizer::Optimizer& getOptimizer() override { return *optimizer_; }
+      
+      virtual llvm::orc::ThreadSafeModule loadModule(const std::string& path) override;
+      
       //hack to retrieve the module
-      virtual void getModule( std::unique_ptr<llvm::Module>& module) override { module = std::move(module_); }
+      virtual void getModule(llvm::orc::ThreadSafeModule& module) override
+      {
+         module = llvm::orc::ThreadSafeModule(std::move(module_), context_);
+      }
       virtual void InitializeModuleAndPassManager() override;
 
       
    private:
       
-      llvm::LLVMContext context_;
-      llvm::IRBuilder<> builder_;
+      llvm::orc::ThreadSafeContext context_; //context of the module being generated
+      std::unique_ptr<llvm::IRBuilder<>> builder_;
       std::unique_ptr<llvm::Module> module_;
       std::unique_ptr<optimizer::Optimizer> optimizer_;
-      std::unordered_map<std::string, llvm::AllocaInst*> namedValues_;
-      precedence_tree_t binaryOperationPrecedence_;
+      std::unordered_map<util::Symbol, llvm::AllocaInst*> namedValues_;
+      util::PrecedenceTable binaryOperationPrecedence_;
       prototype_cache_t prototypeCache_;
+      AST::ASTContext prototypeContext_; //cached prototypes outlive the AST they were parsed in
       
       jit::JIT& jitCompiler_;
+      util::Interner& interner_;
       
    private:
       
       //private interface
       
+      llvm::LLVMContext& getContext() { return *context_.getContext(); }
+      
       ///
       /// @brief: create an alloca instruction at the entry of the block for the function passed
       ///         as argument. Used for mutable variables
       ///
-      AllocaInst *CreateEntryBlockAlloca(Function *function, const std::string &variableName);
+      AllocaInst *CreateEntryBlockAlloca(Function *function, llvm::StringRef variableName);
 
       
       ///
       /// @brief: retrieve a function either from the current module or run the code genetor for it
       ///
-      Function* getFunction(const std::string& name) const;
+      Function* getFunction(util::Symbol name);
       
       
       ///
-      /// @brief: manage assignement 
+      /// @brief: remember a prototype for the modules to come (see addProtypeCache)
       ///
-      Value* manageAssignment(const BinaryExprAST*);
+      void cachePrototype(util::Symbol name,
+                          llvm::ArrayRef<util::Symbol> args,
+                          bool isOperator,
+                          unsigned precedence);
+      
+      ///
+      /// @brief: lower a child, dispatching on the representation it belongs to
+      ///
+      Value* lower(const TreeView&, const ExprAST* node);
+      Value* lower(const AST::FlatAST& ast, AST::NodeId node);
+      
+      ///
+      /// emitters, Tree is either TreeView or FlatAST
+      ///
+      template <typename Tree> Value* emitNumber(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Value* emitVariable(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Value* emitUnary(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Value* emitBinary(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Value* emitAssignment(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Value* emitCall(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Value* emitIf(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Value* emitFor(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Value* emitVar(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Function* emitPrototype(const Tree& tree, typename Tree::node_t node);
+      template <typename Tree> Function* emitFunction(const Tree& tree, typename Tree::node_t node);
+      
+      ///
+      /// visitor entry points
+      ///
+      Value* visitNumberExpr(const NumberExprAST* node) { return codeGenNumberExpr(node); }
+      Value* visitVariableExpr(const VariableExprAST* node) { return codeGenVariableExpr(node); }
+      Value* visitUnaryExpr(const UnaryExprAST* node) { return codeGenUnaryExpr(node); }
+      Value* visitBinaryExpr(const BinaryExprAST* node) { return codeGenBinaryExpr(node); }
+      Value* visitCallExpr(const CallExprAST* node) { return codeGenCallExpr(node); }
+      Value* visitIfExpr(const IfExprAST* node) { return codeGenIfExpr(node); }
+      Value* visitForExpr(const ForExprAST* node) { return codeGenForExpr(node); }
+      Value* visitVarExpr(const VarExprAST* node) { return codeGeneVarExpr(node); }
+      Value* visitPrototype(const PrototypeAST* node) { return codeGenPrototypeExpr(node); }
+      Value* visitFunction(const FunctionAST* node) { return codeGenFunctionExpr(node); }
+      
+      Value* visitNumberExpr(const AST::FlatAST& ast, AST::NodeId node) { return emitNumber(ast, node); }
+      Value* visitVariableExpr(const AST::FlatAST& ast, AST::NodeId node) { return emitVariable(ast, node); }
+      Value* visitUnaryExpr(const AST::FlatAST& ast, AST::NodeId node) { return emitUnary(ast, node); }
+      Value* visitBinaryExpr(const AST::FlatAST& ast, AST::NodeId node) { return emitBinary(ast, node); }
+      Value* visitCallExpr(const AST::FlatAST& ast, AST::NodeId node) { return emitCall(ast, node); }
+      Value* visitIfExpr(const AST::FlatAST& ast, AST::NodeId node) { return emitIf(ast, node); }
+      Value* visitForExpr(const AST::FlatAST& ast, AST::NodeId node) { return emitFor(ast, node); }
+      Value* visitVarExpr(const AST::FlatAST& ast, AST::NodeId node) { return emitVar(ast, node); }
+      Value* visitPrototype(const AST::FlatAST& ast, AST::NodeId node) { return emitPrototype(ast, node); }
+      Value* visitFunction(const AST::FlatAST& ast, AST::NodeId node) { return emitFunction(ast, node); }
       
    };
    
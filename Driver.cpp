@@ -8,9 +8,30 @@
 
 #include "Driver.h"
 #include "Parser.h"
+#include "ObjectEmitter.h"
+#include "Optimizer.h"
 #include <iostream>
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
+#include <thread>
+#include <unistd.h>
+
+
+///
+/// @brief: one compile thread per core, none on a single core: there the parser would only wait for it
+///
+static unsigned getDefaultCompileThreads()
+{
+   auto cores = std::thread::hardware_concurrency();
+   return cores > 1 ? cores : 0;
+}
 
 driver::DriverConfiguration::DriverConfiguration(bool enableJit,
                                                  bool enableOpt,
@@ -18,20 +39,108 @@ driver::DriverConfiguration::DriverConfiguration(bool enableJit,
                                                  bool saveAsObjectFile,
                                                  bool saveAsAsmFile,
                                                  bool saveAsIRFile,
-                                                 bool dumpOnScreen) : enableJit_(enableJit), enableOpt_(enableOpt), enableDebug_(enableDebug), saveAsObjectFile_(saveAsObjectFile), saveAsAsmFile_(saveAsAsmFile),saveAsIRFile_(saveAsIRFile), dumpOnScreen_(dumpOnScreen)
+                                                 parser::DumpLevel dumpLevel) : enableJit_(enableJit), enableOpt_(enableOpt), enableDebug_(enableDebug), saveAsObjectFile_(saveAsObjectFile), saveAsAsmFile_(saveAsAsmFile),saveAsIRFile_(saveAsIRFile), saveAsBitcodeFile_(false), dumpLevel_(dumpLevel), optLevel_(enableOpt ? 2 : 0), optimizeSize_(false), printStats_(false), compileThreads_(getDefaultCompileThreads()), compileMode_(jit::CompileMode::Eager), tierUpThreshold_(1000), objectCache_(false), objectCacheSize_(512ul << 20), expressionCacheSize_(1024), flatAST_(false)
 {}
 
 driver::Driver::Driver(driver::DriverConfiguration cnf) :
    cnf_(std::move(cnf))
 {}
 
-void driver::Driver::go()
+driver::Driver::~Driver() = default;
+
+std::string driver::Driver::getOutputPath(const std::string& input, const char* extension) const
+{
+   if (!cnf_.outputFile_.empty())
+      return cnf_.outputFile_;
+   
+   llvm::SmallString<128> path(input.empty() ? "a" : input);
+   llvm::sys::path::replace_extension(path, extension);
+   return path.str().str();
+}
+
+bool driver::Driver::emitModule(llvm::Module& batch, const std::string& input) const
+{
+   // the files get a copy: the codegen passes and the entry point rewrite it, and the marks of the
+   // optimizer are left out. The jit (and the object cache hashing it) gets the module as it is
+   // without --emit
+   auto copy = llvm::CloneModule(batch);
+   auto& module = *copy;
+   optimizer::Optimizer::stripMarks(module);
+   
+   if (cnf_.saveAsIRFile_)
+   {
+      auto path = getOutputPath(input, "ll");
+      std::error_code error;
+      llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_None);
+      if (error)
+      {
+         std::cerr << "Error: cannot write " << path << ": " << error.message() << "\n";
+         return false;
+      }
+      module.print(out, nullptr);
+   }
+   
+   if (cnf_.saveAsBitcodeFile_)
+   {
+      auto path = getOutputPath(input, "bc");
+      std::error_code error;
+      llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_None);
+      if (error)
+      {
+         std::cerr << "Error: cannot write " << path << ": " << error.message() << "\n";
+         return false;
+      }
+      llvm::WriteBitcodeToFile(module, out);
+   }
+   
+   if (cnf_.saveAsObjectFile_ || cnf_.saveAsAsmFile_)
+   {
+      code_generator::ObjectEmitter::createEntryPoint(module);
+      
+      // the codegen passes rewrite the module they run on: with both files the object is written from a copy
+      if (cnf_.saveAsObjectFile_)
+      {
+         auto copy = cnf_.saveAsAsmFile_ ? llvm::CloneModule(module) : nullptr;
+         if (!emitter_->emit(copy ? *copy : module, getOutputPath(input, "o"), code_generator::ObjectEmitter::ObjectFile))
+            return false;
+      }
+      
+      if (cnf_.saveAsAsmFile_ && !emitter_->emit(module, getOutputPath(input, "s"), code_generator::ObjectEmitter::AssemblyFile))
+         return false;
+   }
+   
+   return true;
+}
+
+optimizer::OptLevel driver::Driver::getOptimizationLevel() const
+{
+   if (!cnf_.enableOpt_)
+      return optimizer::OptLevel::O0;
+   
+   if (cnf_.optimizeSize_)
+      return optimizer::OptLevel::Os;
+   
+   switch (cnf_.optLevel_)
+   {
+      case 0:
+         return optimizer::OptLevel::O0;
+      case 1:
+         return optimizer::OptLevel::O1;
+      case 2:
+         return optimizer::OptLevel::O2;
+      default:
+         return optimizer::OptLevel::O3;
+   }
+}
+
+int driver::Driver::go()
 {
    
    InitializeNativeTarget();
    InitializeNativeTargetAsmPrinter();
    InitializeNativeTargetAsmParser();
    
+   std::unique_ptr<llvm::raw_fd_ostream> dumpFile; //outlives the parser writing to it
    parser::Parser parser_;
    parser_.setTokenPrecedence('=', 2);
    parser_.setTokenPrecedence('<', 10);
@@ -39,8 +148,114 @@ void driver::Driver::go()
    parser_.setTokenPrecedence('-', 30);
    parser_.setTokenPrecedence('*', 40);
    
-   std::cout<<"\n >>";
-   parser_.getNextToken();
-   parser_.mainLoop();
+   bool emit = cnf_.saveAsIRFile_ || cnf_.saveAsBitcodeFile_ || cnf_.saveAsObjectFile_ || cnf_.saveAsAsmFile_;
+   
+   parser_.setJit(cnf_.enableJit_);
+   parser_.setCompileThreads(cnf_.compileThreads_);
+   parser_.setExpressionCache(cnf_.expressionCacheSize_);
+   // the emitted files need their modules optimized as a whole, at once
+   parser_.setCompileMode(cnf_.enableJit_ && !emit ? cnf_.compileMode_ : jit::CompileMode::Eager);
+   parser_.getJitCompiler().setTierUpThreshold(cnf_.tierUpThreshold_);
+   if (cnf_.objectCache_)
+      parser_.getJitCompiler().setObjectCache(cnf_.objectCacheDir_, cnf_.objectCacheSize_);
+   parser_.setOptimizationLevel(getOptimizationLevel());
+   if (!cnf_.passPipeline_.empty() && !parser_.setPassPipeline(cnf_.passPipeline_))
+      return 1;
+   parser_.setDumpLevel(cnf_.dumpLevel_);
+   parser_.setDumpAST(cnf_.enableDebug_);
+   parser_.setFlatAST(cnf_.flatAST_);
+   
+   if (!cnf_.dumpFile_.empty())
+   {
+      std::error_code error;
+      dumpFile = std::make_unique<llvm::raw_fd_ostream>(cnf_.dumpFile_, error, llvm::sys::fs::OF_None);
+      if (error)
+      {
+         std::cerr << "Error: cannot write " << cnf_.dumpFile_ << ": " << error.message() << "\n";
+         return 1;
+      }
+      parser_.setDumpStream(*dumpFile);
+   }
+   
+   for (const auto& file : cnf_.loadFiles_)
+   {
+      if (!parser_.loadModule(file))
+         return 1;
+   }
+   
+   if (cnf_.saveAsObjectFile_ || cnf_.saveAsAsmFile_)
+      emitter_ = std::make_unique<code_generator::ObjectEmitter>(parser_.getJitCompiler().getTargetMachine(), cnf_.optLevel_);
+   
+   int status = 0;
+   std::string input; //input being compiled
+   if (emit)
+   {
+      parser_.setModuleSink([this, &input, &status](llvm::Module& module) {
+         if (!emitModule(module, input))
+            status = 1;
+      });
+   }
+   
+   if (cnf_.inputFiles_.empty())
+   {
+      // a redirected stdin is a whole file, lex it in one go and compile it as a single module,
+      // so is an interactive session whose module goes to disk
+      bool interactive = isatty(STDIN_FILENO);
+      if (!interactive)
+         parser_.tokenizeInput();
+      
+      parser_.setBatchMode(!interactive || emit);
+      
+      if (interactive)
+         std::cout<<"\n >>";
+      
+      parser_.getNextToken();
+      parser_.mainLoop();
+   }
+   else
+   {
+      // every file is a translation unit, compiled as one module. The definitions of a file are
+      // visible to the files that follow
+      parser_.setBatchMode(true);
+      for (const auto& file : cnf_.inputFiles_)
+      {
+         auto source = lexer::createFileInputSource(file);
+         if (!source)
+         {
+            status = 1;
+            continue;
+         }
+         
+         input = file;
+         parser_.setInput(std::move(source));
+         parser_.tokenizeInput();
+         parser_.getNextToken();
+         parser_.mainLoop();
+      }
+   }
+   
+   if (cnf_.printStats_)
+   {
+      // the tier ups asked for by the expressions run so far are part of the session
+      auto& jitCompiler = parser_.getJitCompiler();
+      jitCompiler.waitForTierUps();
+      
+      // by the code generator, and by the jit for tier 1
+      const auto& optimizer = parser_.getCodeGenerator().getOptimizer();
+      const auto& tierUpOptimizer = jitCompiler.getTierUpOptimizer();
+      std::cerr << "functions optimized: " << optimizer.getOptimizedCount() + tierUpOptimizer.getOptimizedCount()
+                << ", more than once: " << optimizer.getReoptimizedCount() + tierUpOptimizer.getReoptimizedCount() << "\n";
+      if (jitCompiler.getCompileMode() == jit::CompileMode::Tiered)
+         std::cerr << "functions tiered up: " << jitCompiler.getTierUpCount() << "\n";
+      std::cerr << "expressions from the cache: " << parser_.getExpressionCache().getHitCount() << "\n";
+      if (cnf_.objectCache_)
+         std::cerr << "objects from the cache: " << jitCompiler.getObjectCacheHitCount()
+                   << ", compiled: " << jitCompiler.getObjectCacheMissCount() << "\n";
+   }
+   
+   // headless runs tell a pipeline that something did not compile
+   if (parser_.getErrorCount() != 0)
+      status = 1;
    
+   return status;
 }
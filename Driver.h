@@ -9,6 +9,27 @@
 #ifndef Driver_h
 #define Driver_h
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DumpLevel.h"
+
+namespace llvm {
+   class Module;
+}
+
+namespace code_generator {
+   class ObjectEmitter;
+}
+
+namespace optimizer {
+   enum class OptLevel;
+}
+
+namespace jit {
+   enum class CompileMode;
+}
 
 namespace driver {
    
@@ -21,15 +42,33 @@ namespace driver {
       bool saveAsObjectFile_;
       bool saveAsAsmFile_;
       bool saveAsIRFile_;
-      bool dumpOnScreen_;
+      bool saveAsBitcodeFile_;
+      parser::DumpLevel dumpLevel_;
+      std::string dumpFile_; //where the dump goes, buffered stderr if empty
       
-      explicit DriverConfiguration(bool enableJit = false,
-                                   bool enableOpt = false,
+      unsigned optLevel_; //0 to 3, enableOpt_ is optLevel_ > 0
+      bool optimizeSize_; //-Os, optLevel_ is 2
+      std::string passPipeline_; //replaces the module pipeline of the level if not empty
+      std::vector<std::string> inputFiles_; //standard input if empty
+      std::string outputFile_; //emitted file, derived from the input name if empty
+      std::vector<std::string> loadFiles_; //precompiled modules added before the inputs
+      bool printStats_; //counters of the session on stderr at exit
+      unsigned compileThreads_; //threads of the jit, 0 compiles on the thread of the parser
+      jit::CompileMode compileMode_; //Eager if modules are emitted
+      unsigned long tierUpThreshold_; //calls to a function before the tiered mode optimizes it
+      bool objectCache_; //compiled objects reused across sessions
+      std::string objectCacheDir_; //the user cache directory if empty
+      unsigned long objectCacheSize_; //bytes
+      unsigned long expressionCacheSize_; //top level expressions the REPL keeps compiled, 0 none
+      bool flatAST_; //parse into the flat AST and generate the IR from it
+      
+      explicit DriverConfiguration(bool enableJit = true,
+                                   bool enableOpt = true,
                                    bool enableDebug = false,
                                    bool saveAsObjectFile = false,
                                    bool saveAsAsmFile = false,
                                    bool saveAsIRFile = false,
-                                   bool dumpOnScreen = true);
+                                   parser::DumpLevel dumpLevel = parser::DumpNone);
       
    };
    
@@ -43,11 +82,30 @@ namespace driver {
    {
    private:
       DriverConfiguration cnf_;
+      std::unique_ptr<code_generator::ObjectEmitter> emitter_; //when native code is emitted
+      
+      ///
+      /// @brief: write a compiled module in the formats selected by the configuration
+      ///
+      bool emitModule(llvm::Module& batch, const std::string& input) const;
+      
+      ///
+      /// @brief: name of the file emitted for an input (empty for the standard input)
+      ///
+      std::string getOutputPath(const std::string& input, const char* extension) const;
+      
+      optimizer::OptLevel getOptimizationLevel() const;
 
    public:
       
       Driver(DriverConfiguration cnf);
-      void go();
+      ~Driver();
+      
+      ///
+      /// @brief: compile the inputs, returns the exit status of the process: 1 if an input could not
+      ///         be read or emitted, or if any error was reported while compiling
+      ///
+      int go();
    };
    
 }
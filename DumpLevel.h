@@ -0,0 +1,26 @@
+//
+//  DumpLevel.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 16/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef DumpLevel_h
+#define DumpLevel_h
+
+namespace parser {
+   
+   ///
+   /// @brief: what is printed of every compiled item
+   ///
+   enum DumpLevel
+   {
+      DumpNone,   //nothing
+      DumpNames,  //the name of the functions generated
+      DumpFull    //their IR
+   };
+   
+}
+
+#endif /* DumpLevel_h */
@@ -0,0 +1,254 @@
+//
+//  ExpressionCache.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#include "ExpressionCache.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+
+#include <algorithm>
+
+namespace parser
+{
+
+   namespace
+   {
+      template <typename T>
+      void append(std::string& out, T value)
+      {
+         out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+      }
+   }
+
+   ExpressionCache::ExpressionCache(util::Interner& interner, jit::JIT& jit, std::size_t capacity) :
+      interner_(interner),
+      jit_(jit),
+      capacity_(capacity),
+      hits_(0)
+   {}
+
+   // the modules go away with the jit
+   ExpressionCache::~ExpressionCache() = default;
+
+   void ExpressionCache::setCapacity(std::size_t capacity)
+   {
+      capacity_ = capacity;
+      while (entries_.size() > capacity_)
+         erase(entries_.find(order_.back()));
+   }
+
+   void ExpressionCache::encode(const AST::FlatAST& ast, AST::NodeId expression)
+   {
+      key_.clear();
+      dependencies_.clear();
+
+      // the children come before their parent and refer to it by index: the walk over the
+      // nodes in order is the whole tree
+      for (AST::NodeId node = 0; node <= expression; ++node)
+      {
+         auto kind = ast.kind(node);
+         append(key_, kind);
+
+         switch (kind)
+         {
+            case AST::ExprAST::NumberKind:
+               append(key_, ast.number(node));
+               break;
+            case AST::ExprAST::VariableKind:
+               append(key_, ast.variableName(node).getId());
+               break;
+            case AST::ExprAST::UnaryKind:
+               append(key_, ast.unaryOpcode(node));
+               append(key_, ast.unaryOperand(node));
+               addDependency(interner_.intern(std::string("unary") + ast.unaryOpcode(node)));
+               break;
+            case AST::ExprAST::BinaryKind:
+               append(key_, ast.binaryOpcode(node));
+               append(key_, ast.binaryLhs(node));
+               append(key_, ast.binaryRhs(node));
+               addDependency(interner_.intern(std::string("binary") + (char)ast.binaryOpcode(node)));
+               break;
+            case AST::ExprAST::CallKind:
+               append(key_, ast.callee(node).getId());
+               append(key_, ast.callArgs(node).size());
+               for (auto arg : ast.callArgs(node))
+                  append(key_, arg);
+               addDependency(ast.callee(node));
+               break;
+            case AST::ExprAST::IfKind:
+               append(key_, ast.ifCondition(node));
+               append(key_, ast.ifThen(node));
+               append(key_, ast.ifElse(node));
+               break;
+            case AST::ExprAST::ForKind:
+               append(key_, ast.forKey(node).getId());
+               append(key_, ast.forStart(node));
+               append(key_, ast.forEnd(node));
+               append(key_, ast.forStep(node));
+               append(key_, ast.forBody(node));
+               break;
+            case AST::ExprAST::VarKind:
+               append(key_, ast.varBindings(node).size());
+               for (const auto& binding : ast.varBindings(node))
+               {
+                  append(key_, binding.first.getId());
+                  append(key_, binding.second);
+               }
+               append(key_, ast.varBody(node));
+               break;
+            case AST::ExprAST::PrototypeKind:
+            case AST::ExprAST::FunctionKind:
+               break; //not in an expression
+         }
+      }
+   }
+
+   void ExpressionCache::addDependency(util::Symbol function)
+   {
+      auto id = function.getId();
+      bool known = std::any_of(dependencies_.begin(), dependencies_.end(), [id](const dependency_t& dependency) {
+         return dependency.first == id;
+      });
+      if (!known)
+         dependencies_.emplace_back(id, getVersion(id));
+   }
+
+   ExpressionCache::version_t ExpressionCache::getVersion(unsigned id) const
+   {
+      auto version = versions_.find(id);
+      return version == versions_.end() ? 0 : version->second;
+   }
+
+   ExpressionCache::entry_point_t ExpressionCache::lookup(const AST::ExprAST* expression)
+   {
+      if (!isEnabled())
+         return nullptr;
+
+      flat_.clear();
+      auto root = flat_.lower(expression);
+      encode(flat_, root);
+      return find();
+   }
+
+   ExpressionCache::entry_point_t ExpressionCache::lookup(const AST::FlatAST& ast, AST::NodeId expression)
+   {
+      if (!isEnabled())
+         return nullptr;
+
+      encode(ast, expression);
+      return find();
+   }
+
+   ExpressionCache::entry_point_t ExpressionCache::find()
+   {
+      auto entry = entries_.find(key_);
+      if (entry == entries_.end())
+         return nullptr;
+
+      // the versions of now were taken by encode()
+      if (entry->second.dependencies != dependencies_)
+      {
+         erase(entry);
+         return nullptr;
+      }
+
+      order_.splice(order_.begin(), order_, entry->second.position);
+      ++hits_;
+      return entry->second.entryPoint;
+   }
+
+   void ExpressionCache::insert(entry_point_t entryPoint, jit::JIT::ModuleHandle module)
+   {
+      if (!isEnabled())
+      {
+         jit_.removeModule(module);
+         return;
+      }
+
+      if (entries_.size() == capacity_)
+         erase(entries_.find(order_.back()));
+
+      order_.push_front(key_);
+      entries_[key_] = Entry{entryPoint, std::move(module), dependencies_, order_.begin()};
+   }
+
+   std::vector<util::Symbol> ExpressionCache::getCallees(const llvm::Function& function)
+   {
+      std::vector<util::Symbol> callees;
+      for (const auto& instruction : llvm::instructions(function))
+      {
+         const auto* call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+         const auto* callee = call ? call->getCalledFunction() : nullptr;
+         if (!callee || callee->isIntrinsic())
+            continue;
+
+         auto symbol = interner_.intern(callee->getName());
+         if (std::find(callees.begin(), callees.end(), symbol) == callees.end())
+            callees.push_back(symbol);
+      }
+      return callees;
+   }
+
+   void ExpressionCache::define(util::Symbol function, const std::vector<util::Symbol>& callees)
+   {
+      auto id = function.getId();
+      auto previous = callees_.find(id);
+      bool redefined = previous != callees_.end();
+
+      // the edges of the previous definition go, the ones of this definition come
+      if (redefined)
+      {
+         for (auto callee : previous->second)
+         {
+            auto& callers = callers_[callee];
+            callers.erase(std::find(callers.begin(), callers.end(), id));
+         }
+      }
+
+      auto& edges = callees_[id];
+      edges.clear();
+      for (auto callee : callees)
+      {
+         edges.push_back(callee.getId());
+         callers_[callee.getId()].push_back(id);
+      }
+
+      // nothing compiled so far can call a function defined for the first time
+      if (!redefined)
+         return;
+
+      // the callers of a stale function are stale, up the call graph
+      llvm::DenseSet<unsigned> stale{id};
+      std::vector<unsigned> pending{id};
+      while (!pending.empty())
+      {
+         auto callee = pending.back();
+         pending.pop_back();
+         ++versions_[callee];
+
+         auto callers = callers_.find(callee);
+         if (callers == callers_.end())
+            continue;
+
+         for (auto caller : callers->second)
+         {
+            if (stale.insert(caller).second)
+               pending.push_back(caller);
+         }
+      }
+   }
+
+   void ExpressionCache::erase(std::unordered_map<std::string, Entry>::iterator entry)
+   {
+      jit_.removeModule(entry->second.module);
+      order_.erase(entry->second.position);
+      entries_.erase(entry);
+   }
+
+}
@@ -0,0 +1,133 @@
+//
+//  ExpressionCache.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef ExpressionCache_h
+#define ExpressionCache_h
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+
+#include "AST.h"
+#include "FlatAST.h"
+#include "Interner.h"
+#include "JIT.h"
+
+namespace parser
+{
+
+   ///
+   /// @brief: top level expressions of the REPL compiled so far, kept in the jit to run again.
+   ///         An expression is found by its canonical form: the flat encoding of its tree, which
+   ///         the spelling (blanks, parentheses, comments) does not change. An entry holds the
+   ///         versions of the functions the expression calls, operators included, when it was
+   ///         compiled: a function defined again makes the entries calling it stale, directly or
+   ///         through other functions, they are dropped and compiled again on their next lookup.
+   ///         At most capacity entries, the one used least recently leaves the jit first
+   ///
+   class ExpressionCache
+   {
+   public:
+
+      using entry_point_t = double (*)();
+      using version_t = std::uint64_t;
+
+      ExpressionCache(util::Interner& interner, jit::JIT& jit, std::size_t capacity = 1024);
+      ~ExpressionCache();
+
+      ExpressionCache(const ExpressionCache&) = delete;
+      ExpressionCache& operator=(const ExpressionCache&) = delete;
+
+      ///
+      /// @brief: number of entries kept, 0 disables the cache
+      ///
+      void setCapacity(std::size_t capacity);
+      bool isEnabled() const { return capacity_ != 0; }
+
+      ///
+      /// @brief: the compiled code of an expression, nullptr if it must be compiled.
+      ///         The canonical form computed stays for the insert() that follows a miss
+      ///
+      entry_point_t lookup(const AST::ExprAST* expression);
+
+      ///
+      /// @brief: the same for an expression parsed in a flat AST. It must be the last node of its
+      ///         tree and the tree the first one of ast: the nodes [0, expression] are the whole
+      ///         expression, as the parser leaves the body of a top level expression
+      ///
+      entry_point_t lookup(const AST::FlatAST& ast, AST::NodeId expression);
+
+      ///
+      /// @brief: keep the code of the expression last looked up, with the module holding it
+      ///
+      void insert(entry_point_t entryPoint, jit::JIT::ModuleHandle module);
+
+      ///
+      /// @brief: the functions and operators the IR of a function calls
+      ///
+      std::vector<util::Symbol> getCallees(const llvm::Function& function);
+      
+      ///
+      /// @brief: a function has a new definition, accepted by the jit, calling callees (see
+      ///         getCallees). If it replaces an earlier one, the entries calling it, or calling a
+      ///         function that calls it, are stale. Walks the callers of the function only
+      ///
+      void define(util::Symbol function, const std::vector<util::Symbol>& callees);
+
+      std::size_t getHitCount() const { return hits_; }
+
+   private:
+
+      using dependency_t = std::pair<unsigned, version_t>; //symbol id, version
+
+      struct Entry
+      {
+         entry_point_t entryPoint;
+         jit::JIT::ModuleHandle module;
+         std::vector<dependency_t> dependencies;
+         std::list<std::string>::iterator position; //in order_
+      };
+
+      ///
+      /// @brief: canonical form and dependencies of the nodes [0, expression] of ast in key_ and
+      ///         dependencies_
+      ///
+      void encode(const AST::FlatAST& ast, AST::NodeId expression);
+      entry_point_t find();
+      void addDependency(util::Symbol function);
+      version_t getVersion(unsigned id) const;
+
+      void erase(std::unordered_map<std::string, Entry>::iterator entry);
+
+      util::Interner& interner_;
+      jit::JIT& jit_;
+      std::size_t capacity_;
+
+      std::unordered_map<std::string, Entry> entries_;
+      std::list<std::string> order_; //keys, most recently used first
+      llvm::DenseMap<unsigned, version_t> versions_; //functions defined again, by symbol id
+      llvm::DenseMap<unsigned, std::vector<unsigned>> callees_; //of every function defined, by symbol id
+      llvm::DenseMap<unsigned, std::vector<unsigned>> callers_; //the reverse of callees_
+
+      AST::FlatAST flat_; //scratch flat copy of the pointer trees looked up
+      std::string key_;
+      std::vector<dependency_t> dependencies_;
+
+      std::size_t hits_;
+   };
+
+}
+
+#endif /* ExpressionCache_h */
@@ -0,0 +1,344 @@
+//
+//  FlatAST.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#include "FlatAST.h"
+#include "ASTVisitor.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace AST
+{
+   namespace
+   {
+      ///
+      /// @brief: copy a pointer tree in a FlatAST, children first
+      ///
+      class Flattener : public ASTVisitor<Flattener, NodeId>
+      {
+      public:
+
+         explicit Flattener(FlatAST& ast) : ast_(ast) {}
+
+         NodeId lower(const ExprAST* node)
+         {
+            return node ? visit(node) : NoNode;
+         }
+
+         NodeId visitNumberExpr(const NumberExprAST* node)
+         {
+            return ast_.addNumber(node->getVal());
+         }
+
+         NodeId visitVariableExpr(const VariableExprAST* node)
+         {
+            return ast_.addVariable(node->getName());
+         }
+
+         NodeId visitUnaryExpr(const UnaryExprAST* node)
+         {
+            return ast_.addUnary(node->getOpcode(), lower(node->getOperand()));
+         }
+
+         NodeId visitBinaryExpr(const BinaryExprAST* node)
+         {
+            auto lhs = lower(node->getLeftOperand());
+            auto rhs = lower(node->getRightOperand());
+            return ast_.addBinary(node->getOpcode(), lhs, rhs);
+         }
+
+         NodeId visitCallExpr(const CallExprAST* node)
+         {
+            llvm::SmallVector<NodeId, 8> args;
+            for (auto arg : node->getArgumentList())
+               args.push_back(lower(arg));
+
+            return ast_.addCall(node->getCallee(), args);
+         }
+
+         NodeId visitIfExpr(const IfExprAST* node)
+         {
+            auto condition = lower(node->getCondion());
+            auto thenBranch = lower(node->getThenBranch());
+            auto elseBranch = lower(node->getElseBranch());
+            return ast_.addIf(condition, thenBranch, elseBranch);
+         }
+
+         NodeId visitForExpr(const ForExprAST* node)
+         {
+            auto start = lower(node->getStart());
+            auto end = lower(node->getEnd());
+            auto step = lower(node->getStep());
+            auto body = lower(node->getBody());
+            return ast_.addFor(node->getKey(), start, end, step, body);
+         }
+
+         NodeId visitVarExpr(const VarExprAST* node)
+         {
+            llvm::SmallVector<FlatAST::binding_t, 4> bindings;
+            for (const auto& variable : node->getVarNames())
+               bindings.push_back(std::make_pair(variable.first, lower(variable.second)));
+
+            auto body = lower(node->getBody());
+            return ast_.addVar(bindings, body);
+         }
+
+         NodeId visitPrototype(const PrototypeAST* node)
+         {
+            return ast_.addPrototype(node->getName(),
+                                     node->getArgumentList(),
+                                     node->isOperator(),
+                                     node->getBinaryPrecedence());
+         }
+
+         NodeId visitFunction(const FunctionAST* node)
+         {
+            auto prototype = lower(node->getPrototype());
+            auto body = lower(node->getBody());
+            return ast_.addFunction(prototype, body);
+         }
+
+      private:
+
+         FlatAST& ast_;
+      };
+
+      template <typename T>
+      std::size_t bytesUsed(const std::vector<T>& nodes)
+      {
+         return nodes.size() * sizeof(T);
+      }
+
+      ///
+      /// @brief: print a flat tree in the format of ExprAST::dump
+      ///
+      class Dumper : public FlatASTVisitor<Dumper, llvm::raw_ostream&>
+      {
+      public:
+
+         using raw_ostream = llvm::raw_ostream;
+
+         raw_ostream& dump(const FlatAST& ast, NodeId node, raw_ostream& out, int ind)
+         {
+            return ast.isNull(node) ? out << "null\n" : visit(ast, node, out, ind);
+         }
+
+         raw_ostream& visitNumberExpr(const FlatAST& ast, NodeId node, raw_ostream& out, int)
+         {
+            return location(out << ast.number(node));
+         }
+
+         raw_ostream& visitVariableExpr(const FlatAST& ast, NodeId node, raw_ostream& out, int)
+         {
+            return location(out << ast.variableName(node).str());
+         }
+
+         raw_ostream& visitUnaryExpr(const FlatAST& ast, NodeId node, raw_ostream& out, int ind)
+         {
+            location(out << "unary" << ast.unaryOpcode(node));
+            return dump(ast, ast.unaryOperand(node), out, ind + 1);
+         }
+
+         raw_ostream& visitBinaryExpr(const FlatAST& ast, NodeId node, raw_ostream& out, int ind)
+         {
+            location(out << "binary" << ast.binaryOpcode(node));
+            dump(ast, ast.binaryLhs(node), indent(out, ind) << "LHS:", ind + 1);
+            return dump(ast, ast.binaryRhs(node), indent(out, ind) << "RHS:", ind + 1);
+         }
+
+         raw_ostream& visitCallExpr(const FlatAST& ast, NodeId node, raw_ostream& out, int ind)
+         {
+            location(out << "Call" << ast.callee(node).str());
+            for (auto arg : ast.callArgs(node))
+               dump(ast, arg, indent(out, ind + 1), ind + 1);
+            return out;
+         }
+
+         raw_ostream& visitIfExpr(const FlatAST& ast, NodeId node, raw_ostream& out, int ind)
+         {
+            location(out << "if");
+            dump(ast, ast.ifCondition(node), indent(out, ind) << "Cond:", ind + 1);
+            dump(ast, ast.ifThen(node), indent(out, ind) << "Then:", ind + 1);
+            return dump(ast, ast.ifElse(node), indent(out, ind) << "Else:", ind + 1);
+         }
+
+         raw_ostream& visitForExpr(const FlatAST& ast, NodeId node, raw_ostream& out, int ind)
+         {
+            location(out << "for");
+            dump(ast, ast.forStart(node), indent(out, ind) << "Cond:", ind + 1);
+            dump(ast, ast.forEnd(node), indent(out, ind) << "End:", ind + 1);
+            dump(ast, ast.forStep(node), indent(out, ind) << "Step:", ind + 1);
+            return dump(ast, ast.forBody(node), indent(out, ind) << "Body:", ind + 1);
+         }
+
+         raw_ostream& visitVarExpr(const FlatAST& ast, NodeId node, raw_ostream& out, int ind)
+         {
+            location(out << "var");
+            for (const auto& binding : ast.varBindings(node))
+               dump(ast, binding.second, indent(out, ind) << binding.first.str() << ':', ind + 1);
+            return dump(ast, ast.varBody(node), indent(out, ind) << "Body:", ind + 1);
+         }
+
+         raw_ostream& visitPrototype(const FlatAST& ast, NodeId node, raw_ostream& out, int ind)
+         {
+            location(out << "prototype " << ast.prototypeName(node).str());
+            for (auto arg : ast.prototypeArgs(node))
+               indent(out, ind + 1) << arg.str() << '\n';
+            return out;
+         }
+
+         raw_ostream& visitFunction(const FlatAST& ast, NodeId node, raw_ostream& out, int ind)
+         {
+            indent(out, ind) << "FunctionAST\n";
+            return dump(ast, ast.functionBody(node), indent(out, ind + 1) << "Body:", ind + 1);
+         }
+
+      private:
+
+         // the flat nodes have no location, ExprAST prints 0:0 as well
+         static raw_ostream& location(raw_ostream& out)
+         {
+            return out << ":0:0\n";
+         }
+
+         static raw_ostream& indent(raw_ostream& out, int size)
+         {
+            return out << std::string(size, ' ');
+         }
+      };
+   }
+
+   template <typename Node>
+   NodeId FlatAST::addNode(ExprAST::Kind kind, std::vector<Node>& nodes, const Node& node)
+   {
+      auto id = static_cast<NodeId>(kinds_.size());
+      kinds_.push_back(kind);
+      slots_.push_back(static_cast<std::uint32_t>(nodes.size()));
+      nodes.push_back(node);
+      return id;
+   }
+
+   NodeId FlatAST::addNumber(double value)
+   {
+      return addNode(ExprAST::NumberKind, numbers_, value);
+   }
+
+   NodeId FlatAST::addVariable(util::Symbol name)
+   {
+      return addNode(ExprAST::VariableKind, variables_, name);
+   }
+
+   NodeId FlatAST::addUnary(char opcode, NodeId operand)
+   {
+      return addNode(ExprAST::UnaryKind, unaries_, UnaryNode{operand, opcode});
+   }
+
+   NodeId FlatAST::addBinary(unsigned char opcode, NodeId lhs, NodeId rhs)
+   {
+      return addNode(ExprAST::BinaryKind, binaries_, BinaryNode{lhs, rhs, opcode});
+   }
+
+   NodeId FlatAST::addCall(util::Symbol callee, llvm::ArrayRef<NodeId> args)
+   {
+      auto first = static_cast<std::uint32_t>(callArgs_.size());
+      callArgs_.insert(callArgs_.end(), args.begin(), args.end());
+      return addNode(ExprAST::CallKind, calls_, CallNode{callee, first, static_cast<std::uint32_t>(args.size())});
+   }
+
+   NodeId FlatAST::addIf(NodeId condition, NodeId thenBranch, NodeId elseBranch)
+   {
+      return addNode(ExprAST::IfKind, ifs_, IfNode{condition, thenBranch, elseBranch});
+   }
+
+   NodeId FlatAST::addFor(util::Symbol key, NodeId start, NodeId end, NodeId step, NodeId body)
+   {
+      return addNode(ExprAST::ForKind, fors_, ForNode{key, start, end, step, body});
+   }
+
+   NodeId FlatAST::addVar(llvm::ArrayRef<binding_t> bindings, NodeId body)
+   {
+      auto first = static_cast<std::uint32_t>(bindings_.size());
+      bindings_.insert(bindings_.end(), bindings.begin(), bindings.end());
+      return addNode(ExprAST::VarKind, vars_, VarNode{first, static_cast<std::uint32_t>(bindings.size()), body});
+   }
+
+   NodeId FlatAST::addPrototype(util::Symbol name, llvm::ArrayRef<util::Symbol> args, bool isOperator, unsigned precedence)
+   {
+      auto first = static_cast<std::uint32_t>(prototypeArgs_.size());
+      prototypeArgs_.insert(prototypeArgs_.end(), args.begin(), args.end());
+      return addNode(ExprAST::PrototypeKind, prototypes_,
+                     PrototypeNode{name, first, static_cast<std::uint32_t>(args.size()), precedence, isOperator});
+   }
+
+   NodeId FlatAST::addFunction(NodeId prototype, NodeId body)
+   {
+      return addNode(ExprAST::FunctionKind, functions_, FunctionNode{prototype, body});
+   }
+
+   NodeId FlatAST::lower(const ExprAST* node)
+   {
+      return Flattener(*this).lower(node);
+   }
+
+   llvm::raw_ostream& FlatAST::dump(llvm::raw_ostream& out, NodeId node, int ind) const
+   {
+      return Dumper().dump(*this, node, out, ind);
+   }
+
+   llvm::ArrayRef<NodeId> FlatAST::callArgs(NodeId node) const
+   {
+      const auto& call = calls_[slot(node, ExprAST::CallKind)];
+      return llvm::makeArrayRef(callArgs_).slice(call.firstArg, call.argCount);
+   }
+
+   llvm::ArrayRef<FlatAST::binding_t> FlatAST::varBindings(NodeId node) const
+   {
+      const auto& var = vars_[slot(node, ExprAST::VarKind)];
+      return llvm::makeArrayRef(bindings_).slice(var.firstBinding, var.bindingCount);
+   }
+
+   llvm::ArrayRef<util::Symbol> FlatAST::prototypeArgs(NodeId node) const
+   {
+      const auto& prototype = prototypes_[slot(node, ExprAST::PrototypeKind)];
+      return llvm::makeArrayRef(prototypeArgs_).slice(prototype.firstArg, prototype.argCount);
+   }
+
+   void FlatAST::clear()
+   {
+      kinds_.clear();
+      slots_.clear();
+      numbers_.clear();
+      variables_.clear();
+      unaries_.clear();
+      binaries_.clear();
+      calls_.clear();
+      ifs_.clear();
+      fors_.clear();
+      vars_.clear();
+      prototypes_.clear();
+      functions_.clear();
+      callArgs_.clear();
+      bindings_.clear();
+      prototypeArgs_.clear();
+   }
+
+   std::size_t FlatAST::size() const
+   {
+      return kinds_.size();
+   }
+
+   std::size_t FlatAST::getMemoryFootprint() const
+   {
+      return bytesUsed(kinds_) + bytesUsed(slots_) +
+             bytesUsed(numbers_) + bytesUsed(variables_) + bytesUsed(unaries_) + bytesUsed(binaries_) +
+             bytesUsed(calls_) + bytesUsed(ifs_) + bytesUsed(fors_) + bytesUsed(vars_) +
+             bytesUsed(prototypes_) + bytesUsed(functions_) +
+             bytesUsed(callArgs_) + bytesUsed(bindings_) + bytesUsed(prototypeArgs_);
+   }
+
+}
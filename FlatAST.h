@@ -0,0 +1,219 @@
+//
+//  FlatAST.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef FlatAST_h
+#define FlatAST_h
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "AST.h"
+#include "Interner.h"
+
+namespace AST
+{
+
+   ///
+   /// @brief: index of a node in a FlatAST
+   ///
+   using NodeId = std::uint32_t;
+   constexpr NodeId NoNode = ~NodeId(0);
+
+   ///
+   /// @brief: flat representation of the AST. Nodes live in contiguous arrays, one per kind
+   ///         (struct of arrays), and refer to their children by 32 bit indices.
+   ///         Every node has an entry in the kind and slot arrays, the slot is its position in
+   ///         the array of its kind. Children are always added before their parent, so a walk
+   ///         over [0, size()) visits a node after all its operands.
+   ///         The node kinds are the same of the pointer tree (ExprAST::Kind)
+   ///
+   class FlatAST
+   {
+   public:
+
+      using node_t = NodeId;
+      using binding_t = std::pair<util::Symbol, NodeId>; //var name, initializer (or NoNode)
+
+      FlatAST() = default;
+
+      FlatAST(const FlatAST&) = delete;
+      FlatAST& operator=(const FlatAST&) = delete;
+
+      ///
+      /// construction
+      ///
+
+      NodeId addNumber(double value);
+      NodeId addVariable(util::Symbol name);
+      NodeId addUnary(char opcode, NodeId operand);
+      NodeId addBinary(unsigned char opcode, NodeId lhs, NodeId rhs);
+      NodeId addCall(util::Symbol callee, llvm::ArrayRef<NodeId> args);
+      NodeId addIf(NodeId condition, NodeId thenBranch, NodeId elseBranch);
+      NodeId addFor(util::Symbol key, NodeId start, NodeId end, NodeId step, NodeId body);
+      NodeId addVar(llvm::ArrayRef<binding_t> bindings, NodeId body);
+      NodeId addPrototype(util::Symbol name, llvm::ArrayRef<util::Symbol> args, bool isOperator, unsigned precedence);
+      NodeId addFunction(NodeId prototype, NodeId body);
+
+      ///
+      /// @brief: append a copy of the tree rooted in node, returns the index of its root
+      ///
+      NodeId lower(const ExprAST* node);
+
+      ///
+      /// @brief: print the tree rooted in node, as ExprAST::dump does
+      ///
+      llvm::raw_ostream& dump(llvm::raw_ostream& out, NodeId node, int ind) const;
+
+      ///
+      /// @brief: drop every node, the arrays keep their capacity
+      ///
+      void clear();
+
+      std::size_t size() const;
+
+      ///
+      /// @brief: bytes used by the nodes (capacity not in use excluded)
+      ///
+      std::size_t getMemoryFootprint() const;
+
+      ///
+      /// access
+      ///
+
+      ExprAST::Kind kind(NodeId node) const { return kinds_[node]; }
+      bool isNull(NodeId node) const { return node == NoNode; }
+
+      double number(NodeId node) const { return numbers_[slot(node, ExprAST::NumberKind)]; }
+      util::Symbol variableName(NodeId node) const { return variables_[slot(node, ExprAST::VariableKind)]; }
+
+      char unaryOpcode(NodeId node) const { return unaries_[slot(node, ExprAST::UnaryKind)].opcode; }
+      NodeId unaryOperand(NodeId node) const { return unaries_[slot(node, ExprAST::UnaryKind)].operand; }
+
+      unsigned char binaryOpcode(NodeId node) const { return binaries_[slot(node, ExprAST::BinaryKind)].opcode; }
+      NodeId binaryLhs(NodeId node) const { return binaries_[slot(node, ExprAST::BinaryKind)].lhs; }
+      NodeId binaryRhs(NodeId node) const { return binaries_[slot(node, ExprAST::BinaryKind)].rhs; }
+
+      util::Symbol callee(NodeId node) const { return calls_[slot(node, ExprAST::CallKind)].callee; }
+      llvm::ArrayRef<NodeId> callArgs(NodeId node) const;
+
+      NodeId ifCondition(NodeId node) const { return ifs_[slot(node, ExprAST::IfKind)].condition; }
+      NodeId ifThen(NodeId node) const { return ifs_[slot(node, ExprAST::IfKind)].thenBranch; }
+      NodeId ifElse(NodeId node) const { return ifs_[slot(node, ExprAST::IfKind)].elseBranch; }
+
+      util::Symbol forKey(NodeId node) const { return fors_[slot(node, ExprAST::ForKind)].key; }
+      NodeId forStart(NodeId node) const { return fors_[slot(node, ExprAST::ForKind)].start; }
+      NodeId forEnd(NodeId node) const { return fors_[slot(node, ExprAST::ForKind)].end; }
+      NodeId forStep(NodeId node) const { return fors_[slot(node, ExprAST::ForKind)].step; }
+      NodeId forBody(NodeId node) const { return fors_[slot(node, ExprAST::ForKind)].body; }
+
+      llvm::ArrayRef<binding_t> varBindings(NodeId node) const;
+      NodeId varBody(NodeId node) const { return vars_[slot(node, ExprAST::VarKind)].body; }
+
+      util::Symbol prototypeName(NodeId node) const { return prototypes_[slot(node, ExprAST::PrototypeKind)].name; }
+      llvm::ArrayRef<util::Symbol> prototypeArgs(NodeId node) const;
+      bool prototypeIsOperator(NodeId node) const { return prototypes_[slot(node, ExprAST::PrototypeKind)].isOperator; }
+      unsigned prototypePrecedence(NodeId node) const { return prototypes_[slot(node, ExprAST::PrototypeKind)].precedence; }
+
+      NodeId functionPrototype(NodeId node) const { return functions_[slot(node, ExprAST::FunctionKind)].prototype; }
+      NodeId functionBody(NodeId node) const { return functions_[slot(node, ExprAST::FunctionKind)].body; }
+
+   private:
+
+      ///
+      /// per kind records, ranges are [first, first + count) of the shared child arrays
+      ///
+
+      struct UnaryNode { NodeId operand; char opcode; };
+      struct BinaryNode { NodeId lhs, rhs; unsigned char opcode; };
+      struct CallNode { util::Symbol callee; std::uint32_t firstArg, argCount; };
+      struct IfNode { NodeId condition, thenBranch, elseBranch; };
+      struct ForNode { util::Symbol key; NodeId start, end, step, body; };
+      struct VarNode { std::uint32_t firstBinding, bindingCount; NodeId body; };
+      struct PrototypeNode { util::Symbol name; std::uint32_t firstArg, argCount; unsigned precedence; bool isOperator; };
+      struct FunctionNode { NodeId prototype, body; };
+
+      std::vector<ExprAST::Kind> kinds_;
+      std::vector<std::uint32_t> slots_;
+
+      std::vector<double> numbers_;
+      std::vector<util::Symbol> variables_;
+      std::vector<UnaryNode> unaries_;
+      std::vector<BinaryNode> binaries_;
+      std::vector<CallNode> calls_;
+      std::vector<IfNode> ifs_;
+      std::vector<ForNode> fors_;
+      std::vector<VarNode> vars_;
+      std::vector<PrototypeNode> prototypes_;
+      std::vector<FunctionNode> functions_;
+
+      std::vector<NodeId> callArgs_;
+      std::vector<binding_t> bindings_;
+      std::vector<util::Symbol> prototypeArgs_;
+
+      std::uint32_t slot(NodeId node, ExprAST::Kind kind) const
+      {
+         assert(kinds_[node] == kind && "wrong kind of flat node");
+         return slots_[node];
+      }
+
+      template <typename Node>
+      NodeId addNode(ExprAST::Kind kind, std::vector<Node>& nodes, const Node& node);
+   };
+
+   ///
+   /// @brief: static visitor over a FlatAST, the flat counterpart of ASTVisitor.
+   ///         Derived implements visitXxx(const FlatAST&, NodeId, Args...) per node kind
+   ///
+   template <typename Derived, typename RetTy>
+   class FlatASTVisitor
+   {
+   public:
+
+      template <typename... Args>
+      RetTy visit(const FlatAST& ast, NodeId node, Args&&... args)
+      {
+         auto& derived = static_cast<Derived&>(*this);
+
+         switch (ast.kind(node))
+         {
+            case ExprAST::NumberKind:
+               return derived.visitNumberExpr(ast, node, std::forward<Args>(args)...);
+            case ExprAST::VariableKind:
+               return derived.visitVariableExpr(ast, node, std::forward<Args>(args)...);
+            case ExprAST::UnaryKind:
+               return derived.visitUnaryExpr(ast, node, std::forward<Args>(args)...);
+            case ExprAST::BinaryKind:
+               return derived.visitBinaryExpr(ast, node, std::forward<Args>(args)...);
+            case ExprAST::CallKind:
+               return derived.visitCallExpr(ast, node, std::forward<Args>(args)...);
+            case ExprAST::IfKind:
+               return derived.visitIfExpr(ast, node, std::forward<Args>(args)...);
+            case ExprAST::ForKind:
+               return derived.visitForExpr(ast, node, std::forward<Args>(args)...);
+            case ExprAST::VarKind:
+               return derived.visitVarExpr(ast, node, std::forward<Args>(args)...);
+            case ExprAST::PrototypeKind:
+               return derived.visitPrototype(ast, node, std::forward<Args>(args)...);
+            case ExprAST::FunctionKind:
+               return derived.visitFunction(ast, node, std::forward<Args>(args)...);
+         }
+
+         llvm_unreachable("unknown flat node kind");
+      }
+   };
+
+}
+
+#endif /* FlatAST_h */
@@ -0,0 +1,152 @@
+//
+//  InputSource.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#include "InputSource.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lexer
+{
+
+   ///
+   /// BufferedInputSource
+   ///
+
+   BufferedInputSource::BufferedInputSource(int fd, bool ownsFd, std::size_t capacity) :
+   fd_(fd),
+   ownsFd_(ownsFd),
+   eof_(false),
+   buffer_(capacity)
+   {
+      begin_ = end_ = buffer_.data();
+   }
+
+   BufferedInputSource::~BufferedInputSource()
+   {
+      if (ownsFd_)
+         ::close(fd_);
+   }
+
+   bool BufferedInputSource::refill(const char* keep)
+   {
+      // slide the bytes still in use to the front of the buffer
+      std::size_t kept = end_ - keep;
+      std::memmove(buffer_.data(), keep, kept);
+
+      // a single token is as big as the whole buffer, make room for it
+      if (kept == buffer_.size())
+         buffer_.resize(buffer_.size() * 2);
+
+      begin_ = buffer_.data();
+      end_ = begin_ + kept;
+
+      if (eof_)
+         return false;
+
+      // read() returns as soon as some input is there, so an interactive stdin is served line by line
+      ssize_t bytesRead;
+      do
+      {
+         bytesRead = ::read(fd_, buffer_.data() + kept, buffer_.size() - kept);
+      } while (bytesRead < 0 && errno == EINTR);
+
+      if (bytesRead <= 0)
+      {
+         eof_ = true;
+         return false;
+      }
+
+      end_ += bytesRead;
+      return true;
+   }
+
+   ///
+   /// MappedFileInputSource
+   ///
+
+   MappedFileInputSource::MappedFileInputSource(int fd, void* address, std::size_t size) :
+   fd_(fd),
+   address_(address),
+   size_(size)
+   {
+      begin_ = static_cast<const char*>(address_);
+      end_ = begin_ + size_;
+   }
+
+   MappedFileInputSource::~MappedFileInputSource()
+   {
+      ::munmap(address_, size_);
+      ::close(fd_);
+   }
+
+   bool MappedFileInputSource::refill(const char* keep)
+   {
+      // the whole file is already mapped, the window just starts at keep
+      begin_ = keep;
+      return false;
+   }
+
+   ///
+   /// StringInputSource
+   ///
+
+   StringInputSource::StringInputSource(std::string text) :
+   text_(std::move(text))
+   {
+      begin_ = text_.data();
+      end_ = begin_ + text_.size();
+   }
+
+   bool StringInputSource::refill(const char* keep)
+   {
+      begin_ = keep;
+      return false;
+   }
+
+   ///
+   /// factories
+   ///
+
+   std::unique_ptr<InputSource> createStdinInputSource()
+   {
+      return std::make_unique<BufferedInputSource>(STDIN_FILENO);
+   }
+
+   std::unique_ptr<InputSource> createFileInputSource(const std::string& path)
+   {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+      {
+         std::cerr << "Error: cannot open " << path << ": " << std::strerror(errno) << "\n";
+         return nullptr;
+      }
+
+      struct stat info;
+      if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+      {
+         auto size = static_cast<std::size_t>(info.st_size);
+         void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (address != MAP_FAILED)
+         {
+            ::madvise(address, size, MADV_SEQUENTIAL);
+            return std::make_unique<MappedFileInputSource>(fd, address, size);
+         }
+      }
+
+      // empty files, pipes and anything mmap refuses are read in chunks
+      return std::make_unique<BufferedInputSource>(fd, true);
+   }
+
+}
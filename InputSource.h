@@ -0,0 +1,125 @@
+//
+//  InputSource.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef InputSource_h
+#define InputSource_h
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lexer
+{
+
+   ///
+   /// @brief: input of the lexer. A source exposes its content as a contiguous window of bytes
+   ///         [begin, end) that the lexer scans directly, without any call per character.
+   ///         Sources that do not hold the whole input in memory slide the window with refill()
+   ///
+   class InputSource
+   {
+   public:
+
+      virtual ~InputSource() = default;
+
+      const char* begin() const { return begin_; }
+      const char* end() const { return end_; }
+
+      ///
+      /// @brief: fetch more input. The bytes in [keep, end()) are preserved and moved to the front of
+      ///         the new window, every other pointer into the old window is invalidated.
+      ///         Returns false when no more bytes are available
+      ///
+      virtual bool refill(const char* keep) = 0;
+
+   protected:
+
+      const char* begin_ = nullptr;
+      const char* end_ = nullptr;
+   };
+
+   ///
+   /// @brief: source reading a file descriptor in large chunks (stdin, pipes, ...)
+   ///         The window grows when a single token does not fit in it
+   ///
+   class BufferedInputSource : public InputSource
+   {
+   public:
+
+      explicit BufferedInputSource(int fd, bool ownsFd = false, std::size_t capacity = 1 << 16);
+      ~BufferedInputSource() override;
+
+      BufferedInputSource(const BufferedInputSource&) = delete;
+      BufferedInputSource& operator=(const BufferedInputSource&) = delete;
+
+      bool refill(const char* keep) override;
+
+   private:
+
+      int fd_;
+      bool ownsFd_;
+      bool eof_;
+      std::vector<char> buffer_;
+   };
+
+   ///
+   /// @brief: source backed by a read only memory mapping of a regular file
+   ///
+   class MappedFileInputSource : public InputSource
+   {
+   public:
+
+      MappedFileInputSource(int fd, void* address, std::size_t size);
+      ~MappedFileInputSource() override;
+
+      MappedFileInputSource(const MappedFileInputSource&) = delete;
+      MappedFileInputSource& operator=(const MappedFileInputSource&) = delete;
+
+      bool refill(const char* keep) override;
+
+   private:
+
+      int fd_;
+      void* address_;
+      std::size_t size_;
+   };
+
+   ///
+   /// @brief: source over an in-memory string
+   ///
+   class StringInputSource : public InputSource
+   {
+   public:
+
+      explicit StringInputSource(std::string text);
+
+      StringInputSource(const StringInputSource&) = delete;
+      StringInputSource& operator=(const StringInputSource&) = delete;
+
+      bool refill(const char* keep) override;
+
+   private:
+
+      std::string text_;
+   };
+
+   ///
+   /// @brief: buffered source on the standard input
+   ///
+   std::unique_ptr<InputSource> createStdinInputSource();
+
+   ///
+   /// @brief: open a file, memory mapping it when possible and falling back to buffered reads
+   ///         otherwise (fifo, character devices). Returns nullptr if the file cannot be opened
+   ///
+   std::unique_ptr<InputSource> createFileInputSource(const std::string& path);
+
+}
+
+#endif /* InputSource_h */
@@ -0,0 +1,37 @@
+//
+//  Interner.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#include "Interner.h"
+
+#include <cassert>
+
+namespace util
+{
+
+   Symbol Interner::intern(llvm::StringRef spelling)
+   {
+      auto inserted = table_.insert(std::make_pair(spelling, static_cast<unsigned>(symbols_.size())));
+      const auto* entry = &*inserted.first;
+      if (inserted.second)
+         symbols_.push_back(entry);
+
+      return Symbol(entry);
+   }
+
+   Symbol Interner::lookup(unsigned id) const
+   {
+      assert(id < symbols_.size() && "symbol id not interned");
+      return Symbol(symbols_[id]);
+   }
+
+   std::size_t Interner::size() const
+   {
+      return symbols_.size();
+   }
+
+}
@@ -0,0 +1,94 @@
+//
+//  Interner.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef Interner_h
+#define Interner_h
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+
+namespace util
+{
+
+   ///
+   /// @brief: handle to an identifier interned by an Interner. Symbols of the same interner are equal
+   ///         iff their spelling is equal, so they are compared and hashed by id only.
+   ///         The spelling stays valid as long as the interner is alive
+   ///
+   class Symbol
+   {
+   public:
+
+      using entry_t = llvm::StringMapEntry<unsigned>;
+
+      Symbol() : entry_(nullptr) {}
+      explicit Symbol(const entry_t* entry) : entry_(entry) {}
+
+      unsigned getId() const { return entry_->getValue(); }
+      llvm::StringRef str() const { return entry_ ? entry_->getKey() : llvm::StringRef(); }
+
+      explicit operator bool() const { return entry_ != nullptr; }
+      bool operator==(Symbol rhs) const { return entry_ == rhs.entry_; }
+      bool operator!=(Symbol rhs) const { return entry_ != rhs.entry_; }
+
+   private:
+
+      const entry_t* entry_;
+   };
+
+   ///
+   /// @brief: per compilation table of identifiers. Every distinct spelling is copied once, into
+   ///         the interner's own arena, and gets a dense id starting from 0
+   ///
+   class Interner
+   {
+   public:
+
+      explicit Interner() = default;
+
+      Interner(const Interner&) = delete;
+      Interner& operator=(const Interner&) = delete;
+
+      ///
+      /// @brief: return the symbol for spelling, adding it if it was never seen before
+      ///
+      Symbol intern(llvm::StringRef spelling);
+
+      ///
+      /// @brief: symbol with the id passed, it must have been returned by intern()
+      ///
+      Symbol lookup(unsigned id) const;
+
+      std::size_t size() const;
+
+   private:
+
+      llvm::StringMap<unsigned, llvm::BumpPtrAllocator> table_;
+      std::vector<const Symbol::entry_t*> symbols_; //id -> entry
+   };
+
+}
+
+namespace std
+{
+   template <>
+   struct hash<util::Symbol>
+   {
+      std::size_t operator()(util::Symbol symbol) const
+      {
+         return symbol.getId();
+      }
+   };
+}
+
+#endif /* Interner_h */
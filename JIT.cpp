@@ -8,19 +8,17 @@
 
 #include "JIT.h"
 
-#include "llvm/ExecutionEngine/SectionMemoryManager.h"
-#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
-#include "llvm/Support/DynamicLibrary.h"
-#include "llvm/ExecutionEngine/JITSymbol.h"
-#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
-#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
-#include "llvm/IR/Mangler.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/raw_ostream.h"
-#include "llvm/Support/TargetSelect.h"
-#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <memory>
@@ -29,79 +27,612 @@
 
 namespace jit
 {
+   namespace
+   {
+      std::unique_ptr<llvm::TargetMachine> createHostTargetMachine()
+      {
+         auto builder = llvm::cantFail(llvm::orc::JITTargetMachineBuilder::detectHost());
+         return llvm::cantFail(builder.createTargetMachine());
+      }
+      
+      void reportError(llvm::Error error)
+      {
+         std::cerr << "Error: " << llvm::toString(std::move(error)) << "\n";
+      }
+      
+      ///
+      /// tiered mode: names of the two tiers of a function (the stub has the name of the function)
+      /// and of the callback of the counters
+      ///
+      const char* const Tier0Suffix = ".tier0";
+      const char* const Tier1Suffix = ".tier1";
+      const char* const TierUpHook = "__kaleidoscope_tier_up";
+      
+      ///
+      /// the jit the counters call back, passed to the hook. An absolute symbol rather than a
+      /// constant in the IR: the same module compiles to the same object in every process, so
+      /// tier 0 can come from the object cache
+      ///
+      const char* const JITInstance = "__kaleidoscope_jit";
+      
+      ///
+      /// name of a function called through a stub out of the tiered mode
+      ///
+      const char* const BodySuffix = ".body";
+      
+      ///
+      /// @brief: name of the body of a function called through a stub. The number keeps apart
+      ///         the bodies of two definitions, the new one is compiled before the old one goes
+      ///
+      std::string bodyName(const std::string& name, const char* suffix, std::uint64_t number)
+      {
+         return name + suffix + "." + std::to_string(number);
+      }
+      
+      ///
+      /// @brief: the callers of function, recursive calls included, go through the stub, which
+      ///         gets the name of the function. The function gets the name of its body
+      ///
+      void redirectToStub(llvm::Module& module, llvm::Function& function, const std::string& body)
+      {
+         auto name = function.getName().str();
+         function.setName(body);
+         auto stub = llvm::Function::Create(function.getFunctionType(), llvm::Function::ExternalLinkage, name, &module);
+         function.replaceAllUsesWith(stub);
+      }
+   }
+   
    JIT::JIT() :
-      targetMachine_(engineBuilder_.selectTarget()),
-      dataLayout_(llvm::DataLayout(targetMachine_->createDataLayout())),
-      objectLayer_([]() { return std::make_shared<llvm::SectionMemoryManager>(); }),
-      compileLayer_(objectLayer_,llvm::orc::SimpleCompiler(*targetMachine_)),
-      optimizeLayer_(compileLayer_, [this](std::shared_ptr<llvm::Module> M) {return optimizeModule(std::move(M));})
+      targetMachine_(createHostTargetMachine()),
+      dataLayout_(targetMachine_->createDataLayout()),
+      objectCacheEnabled_(false),
+      objectCacheSize_(0),
+      jit_(nullptr),
+      compileThreads_(0),
+      mode_(CompileMode::Eager),
+      redefinition_(false),
+      stubs_(nullptr),
+      stubbedModules_(0),
+      tierUpMachine_(nullptr),
+      tierUpOptimizer_(optimizer::OptLevel::O2),
+      tierUpThreshold_(1000),
+      tierUpCount_(0),
+      tierUpThread_(nullptr)
    {
-      llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+      tierUpOptimizer_.setPolicy(optimizer::Policy::PerModule);
    }
    
+   JIT::~JIT() = default;
+   
    llvm::TargetMachine &JIT::getTargetMachine() const
    {
       return *targetMachine_;
    }
    
-   JIT::ModuleHandle JIT::addModule(std::unique_ptr<llvm::Module>& module)
+   void JIT::setCompileThreads(unsigned compileThreads)
    {
-      //first function to invoke in order to resolve symbol
-      auto firstResolver = [&](const std::string &name)
+      compileThreads_ = compileThreads;
+   }
+   
+   unsigned JIT::getCompileThreads() const
+   {
+      return compileThreads_;
+   }
+   
+   void JIT::setCompileMode(CompileMode mode)
+   {
+      mode_ = mode;
+   }
+   
+   CompileMode JIT::getCompileMode() const
+   {
+      return mode_;
+   }
+   
+   void JIT::setTierUpThreshold(std::uint64_t calls)
+   {
+      tierUpThreshold_ = calls;
+   }
+   
+   void JIT::setObjectCache(std::string directory, std::uint64_t maxSize)
+   {
+      objectCacheEnabled_ = true;
+      objectCacheDirectory_ = std::move(directory);
+      objectCacheSize_ = maxSize;
+   }
+   
+   std::size_t JIT::getObjectCacheHitCount() const
+   {
+      return (objectCache_ ? objectCache_->getHitCount() : 0) + (tierUpObjectCache_ ? tierUpObjectCache_->getHitCount() : 0);
+   }
+   
+   std::size_t JIT::getObjectCacheMissCount() const
+   {
+      return (objectCache_ ? objectCache_->getMissCount() : 0) + (tierUpObjectCache_ ? tierUpObjectCache_->getMissCount() : 0);
+   }
+   
+   optimizer::Optimizer& JIT::getTierUpOptimizer()
+   {
+      return tierUpOptimizer_;
+   }
+   
+   std::size_t JIT::getTierUpCount() const
+   {
+      return tierUpCount_;
+   }
+   
+   void JIT::waitForTierUps()
+   {
+      if (tierUpThread_)
+         tierUpThread_->wait();
+   }
+   
+   void JIT::setModuleTransform(std::function<void(llvm::Module&)> transform)
+   {
+      transform_ = std::move(transform);
+   }
+   
+   void JIT::setRedefinition(bool enable)
+   {
+      redefinition_ = enable;
+   }
+   
+   llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> JIT::createJIT()
+   {
+      auto machine = llvm::orc::JITTargetMachineBuilder::detectHost();
+      if (!machine)
+         return machine.takeError();
+      
+      // tier 0 is about compiling fast, the code of tier 1 comes from tierUpMachine_
+      auto optLevel = mode_ == CompileMode::Tiered ? llvm::CodeGenOpt::None : llvm::CodeGenOpt::Default;
+      machine->setCodeGenOptLevel(optLevel);
+      
+      // the compilers LLJIT builds by default, with the cache. A cache that cannot be used is reported and skipped
+      llvm::orc::LLJITBuilderState::CompileFunctionCreator createCompiler;
+      if (objectCacheEnabled_)
       {
-         if (auto symbol = optimizeLayer_.findSymbol(name, false)) return symbol;
-         return llvm::JITSymbol(nullptr);
-      };
+         auto target = ObjectCache::describeTarget(machine->getTargetTriple().str(), machine->getCPU(),
+                                                   machine->getFeatures().getString(), optLevel);
+         objectCache_ = createObjectCache(objectCacheDirectory_, objectCacheSize_, std::move(target));
+      }
+      if (objectCache_)
+      {
+         createCompiler = [this](llvm::orc::JITTargetMachineBuilder machine)
+            -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+            if (compileThreads_ != 0)
+               return std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(machine), objectCache_.get());
+            
+            auto targetMachine = machine.createTargetMachine();
+            if (!targetMachine)
+               return targetMachine.takeError();
+            return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*targetMachine), objectCache_.get());
+         };
+      }
+      
+      if (mode_ != CompileMode::Lazy)
+      {
+         return llvm::orc::LLJITBuilder()
+            .setJITTargetMachineBuilder(std::move(*machine))
+            .setNumCompileThreads(compileThreads_)
+            .setCompileFunctionCreator(std::move(createCompiler))
+            .create();
+      }
+      
+      auto jit = llvm::orc::LLLazyJITBuilder()
+         .setJITTargetMachineBuilder(std::move(*machine))
+         .setNumCompileThreads(compileThreads_)
+         .setCompileFunctionCreator(std::move(createCompiler))
+         .create();
+      if (!jit)
+         return jit.takeError();
+      
+      // one function per partition: a call compiles its callee and nothing else
+      (*jit)->setPartitionFunction(llvm::orc::CompileOnDemandLayer::compileRequested);
+      return std::unique_ptr<llvm::orc::LLJIT>(std::move(*jit));
+   }
+   
+   llvm::orc::LLJIT* JIT::getJIT()
+   {
+      if (jit_)
+         return jit_.get();
+      
+      auto jit = createJIT();
+      if (!jit)
+      {
+         reportError(jit.takeError());
+         return nullptr;
+      }
+      
+      jit_ = std::move(*jit);
+      
+      if (transform_)
+      {
+         jit_->getIRTransformLayer().setTransform([this](llvm::orc::ThreadSafeModule module,
+                                                         llvm::orc::MaterializationResponsibility&) {
+            module.withModuleDo(transform_);
+            return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(module));
+         });
+      }
+      
+      // the runtime of the language (putchard, printd...) is resolved in the process
+      auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(dataLayout_.getGlobalPrefix());
+      if (!generator)
+      {
+         reportError(generator.takeError());
+         return nullptr;
+      }
+      jit_->getMainJITDylib().addGenerator(std::move(*generator));
+      
+      // the tiered mode calls every function through a stub, the redefinition the functions it adds
+      stubs_ = llvm::orc::createLocalIndirectStubsManagerBuilder(targetMachine_->getTargetTriple())();
+      
+      if (mode_ == CompileMode::Tiered)
+      {
+         tierUpMachine_ = createHostTargetMachine();
+         tierUpMachine_->setOptLevel(llvm::CodeGenOpt::Aggressive);
+         tierUpOptimizer_.setTargetMachine(*tierUpMachine_);
+         if (objectCacheEnabled_)
+            tierUpObjectCache_ = createObjectCache(objectCacheDirectory_, objectCacheSize_, ObjectCache::describeTarget(*tierUpMachine_));
+         tierUpThread_ = std::make_unique<llvm::ThreadPool>(llvm::hardware_concurrency(1));
+         
+         // the counters of tier 0 call back here
+         auto hook = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&JIT::tierUpEntry),
+                                              llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+         auto instance = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(this), llvm::JITSymbolFlags::Exported);
+         if (auto error = jit_->getMainJITDylib().define(llvm::orc::absoluteSymbols({{jit_->mangleAndIntern(TierUpHook), hook},
+                                                                                    {jit_->mangleAndIntern(JITInstance), instance}})))
+         {
+            reportError(std::move(error));
+            return nullptr;
+         }
+      }
+      
+      return jit_.get();
+   }
+   
+   JIT::ModuleHandle JIT::addModule(llvm::orc::ThreadSafeModule module, bool compileNow)
+   {
+      auto jit = getJIT();
+      if (!jit)
+         return nullptr;
+      
+      if ((mode_ == CompileMode::Tiered || redefinition_) && !compileNow)
+         return addStubbedModule(std::move(module));
+      
+      bool lazy = mode_ == CompileMode::Lazy && !compileNow;
+      
+      // what the module defines, compiled now rather than on the first lookup
+      llvm::orc::SymbolLookupSet symbols;
+      if (compileThreads_ != 0 && !lazy)
+      {
+         module.withModuleDo([&](llvm::Module& m) {
+            for (const auto& function : m)
+            {
+               if (!function.isDeclaration() && !function.hasLocalLinkage())
+                  symbols.add(jit->mangleAndIntern(function.getName()));
+            }
+         });
+      }
       
-      //second resolver to invoke in order to resolve external symbols not found by resolver 1
-      auto secondResolver = [](const std::string &name) {
-         if (auto synbolAddress = llvm::RTDyldMemoryManager::getSymbolAddressInProcess(name))
-            return llvm::JITSymbol(synbolAddress, llvm::JITSymbolFlags::Exported);
-         return llvm::JITSymbol(nullptr);
+      auto& library = jit->getMainJITDylib();
+      auto tracker = library.createResourceTracker();
+      // lazy: the compile on demand layer puts stubs in place of the functions of the module
+      auto error = lazy
+         ? static_cast<llvm::orc::LLLazyJIT*>(jit)->getCompileOnDemandLayer().add(tracker, std::move(module))
+         : jit->addIRModule(tracker, std::move(module));
+      if (error)
+      {
+         reportError(std::move(error));
+         return nullptr;
+      }
+      
+      if (!symbols.empty())
+      {
+         // the lookup hands the compilation to the pool and returns, its result is not waited for
+         jit->getExecutionSession().lookup(llvm::orc::LookupKind::Static,
+                                           llvm::orc::makeJITDylibSearchOrder(&library),
+                                           std::move(symbols),
+                                           llvm::orc::SymbolState::Ready,
+                                           [](llvm::Expected<llvm::orc::SymbolMap> result) {
+                                              if (!result)
+                                                 reportError(result.takeError());
+                                           },
+                                           llvm::orc::NoDependenciesToRegister);
+      }
+      
+      return tracker;
+   }
+   
+   JIT::ModuleHandle JIT::addStubbedModule(llvm::orc::ThreadSafeModule module)
+   {
+      std::vector<std::string> names;
+      module.withModuleDo([&](llvm::Module& m) {
+         for (const auto& function : m)
+         {
+            if (!function.isDeclaration() && !function.hasLocalLinkage())
+               names.push_back(function.getName().str());
+         }
+      });
+      
+      // every name is checked before anything changes: a module refused leaves no trace
+      std::vector<ModuleHandle> replaced;
+      for (const auto& name : names)
+      {
+         auto defined = stubbedFunctions_.find(name);
+         if (defined == stubbedFunctions_.end())
+            continue;
+         
+         if (!redefinition_)
+         {
+            std::cerr << "Error: duplicate definition of symbol " << name << "\n";
+            return nullptr;
+         }
+         
+         // the module replaced goes away whole, this one must define what it did
+         for (const auto& function : stubbedFunctions_)
+         {
+            if (function.second.module == defined->second.module &&
+                std::find(names.begin(), names.end(), function.first) == names.end())
+            {
+               std::cerr << "Error: cannot define " << name << " again without " << function.first << ", defined with it\n";
+               return nullptr;
+            }
+         }
+         if (std::find(replaced.begin(), replaced.end(), defined->second.module) == replaced.end())
+            replaced.push_back(defined->second.module);
+      }
+      
+      // the stubs first, the module calls them. The stub of a removed definition is used again,
+      // its symbol is defined once, on its own: a name defined elsewhere is refused here
+      auto& library = jit_->getMainJITDylib();
+      auto tracker = library.createResourceTracker();
+      std::vector<std::string> added; //names with a new symbol
+      auto refuse = [&](llvm::Error error) {
+         // the definitions replaced stay, their stubs were not touched
+         reportError(std::move(error));
+         releaseModule(tracker);
+         for (const auto& name : added)
+         {
+            releaseModule(stubbedFunctions_[name].symbol);
+            stubbedFunctions_.erase(name);
+         }
+         return nullptr;
       };
+      for (const auto& name : names)
+      {
+         if (stubbedFunctions_.count(name))
+            continue;
+         
+         if (!stubs_->findStub(name, true))
+         {
+            auto flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+            if (auto error = stubs_->createStub(name, 0, flags))
+               return refuse(std::move(error));
+         }
+         
+         auto symbol = library.createResourceTracker();
+         auto stub = stubs_->findStub(name, true);
+         if (auto error = library.define(llvm::orc::absoluteSymbols({{jit_->mangleAndIntern(name), stub}}), symbol))
+            return refuse(std::move(error));
+         
+         stubbedFunctions_[name] = StubbedFunction{symbol, nullptr};
+         added.push_back(name);
+      }
+      
+      std::vector<std::string> bodies;
+      if (mode_ == CompileMode::Tiered)
+      {
+         // the functions as they come, tier 1 starts from them
+         auto original = std::make_shared<llvm::orc::ThreadSafeModule>(llvm::orc::cloneToNewContext(module));
+         
+         module.withModuleDo([&](llvm::Module& m) {
+            std::lock_guard<std::mutex> lock(tieredFunctionsMutex_);
+            for (const auto& name : names)
+            {
+               auto id = tieredFunctions_.size();
+               instrument(m, *m.getFunction(name), id);
+               tieredFunctions_.push_back(TieredFunction{name, original, tracker});
+               bodies.push_back(bodyName(name, Tier0Suffix, id));
+            }
+         });
+      }
+      else
+      {
+         auto number = stubbedModules_++;
+         module.withModuleDo([&](llvm::Module& m) {
+            for (const auto& name : names)
+            {
+               bodies.push_back(bodyName(name, BodySuffix, number));
+               redirectToStub(m, *m.getFunction(name), bodies.back());
+            }
+         });
+      }
       
+      // lazy: the compile on demand layer puts stubs in place of the bodies, the lookups below
+      // return them and a body is compiled on its first call
+      auto error = mode_ == CompileMode::Lazy
+         ? static_cast<llvm::orc::LLLazyJIT*>(jit_.get())->getCompileOnDemandLayer().add(tracker, std::move(module))
+         : jit_->addIRModule(tracker, std::move(module));
+      if (error)
+         return refuse(std::move(error));
       
-      auto resolver = llvm::orc::createLambdaResolver(firstResolver, secondResolver);
-      //return cantFail(compileLayer_.addModule(std::move(module), std::move(resolver)));
-      return cantFail(optimizeLayer_.addModule(std::move(module), std::move(resolver)));
+      // compiled now: an unresolved symbol fails here, while the stubs still point to the old code
+      std::vector<llvm::JITTargetAddress> addresses;
+      for (const auto& body : bodies)
+      {
+         auto symbol = jit_->lookup(body);
+         if (!symbol)
+            return refuse(symbol.takeError());
+         addresses.push_back(symbol->getAddress());
+      }
+      
+      for (std::size_t i = 0; i < names.size(); ++i)
+      {
+         if (auto error = stubs_->updatePointer(names[i], addresses[i]))
+            return refuse(std::move(error));
+         stubbedFunctions_[names[i]].module = tracker;
+      }
+      
+      // no stub points to them any more
+      for (const auto& handle : replaced)
+         releaseModule(handle);
+      
+      return tracker;
    }
    
-   llvm::JITSymbol JIT::findSymbol(const std::string& name) {
-      std::string MangledName;
-      llvm::raw_string_ostream MangledNameStream(MangledName);
-      llvm::Mangler::getNameWithPrefix(MangledNameStream, name, dataLayout_);
-      //return compileLayer_.findSymbol(MangledNameStream.str(), true);
+   void JIT::instrument(llvm::Module& module, llvm::Function& function, std::uint64_t id)
+   {
+      auto name = function.getName().str();
+      redirectToStub(module, function, bodyName(name, Tier0Suffix, id));
+      
+      auto counterType = llvm::Type::getInt64Ty(module.getContext());
+      auto counter = new llvm::GlobalVariable(module, counterType, false, llvm::GlobalValue::InternalLinkage,
+                                              llvm::ConstantInt::get(counterType, 0), name + ".calls");
       
-      return optimizeLayer_.findSymbol(MangledNameStream.str(), true);
+      // ++calls == threshold: the call asking for tier 1 is made once
+      auto& entry = function.getEntryBlock();
+      llvm::IRBuilder<> builder(&entry, entry.getFirstInsertionPt());
+      auto calls = builder.CreateAdd(builder.CreateLoad(counterType, counter), builder.getInt64(1));
+      builder.CreateStore(calls, counter);
+      auto hot = builder.CreateICmpEQ(calls, builder.getInt64(tierUpThreshold_));
+      
+      builder.SetInsertPoint(llvm::SplitBlockAndInsertIfThen(hot, &*builder.GetInsertPoint(), false));
+      auto hookType = llvm::FunctionType::get(builder.getVoidTy(), {counterType, counterType}, false);
+      auto hook = module.getOrInsertFunction(TierUpHook, hookType);
+      auto instance = module.getOrInsertGlobal(JITInstance, builder.getInt8Ty());
+      builder.CreateCall(hook, {builder.CreatePtrToInt(instance, counterType), builder.getInt64(id)});
    }
    
-   llvm::JITTargetAddress JIT::getSymbolAddress(const std::string& name) {
-      return cantFail(findSymbol(name).getAddress());
+   void JIT::tierUpEntry(std::uint64_t jit, std::uint64_t id)
+   {
+      reinterpret_cast<JIT*>(jit)->tierUp(id);
+   }
+   
+   void JIT::tierUp(std::uint64_t id)
+   {
+      // the caller goes on in tier 0 meanwhile
+      tierUpThread_->async([this, id] { recompile(id); });
+   }
+   
+   void JIT::recompile(std::uint64_t id)
+   {
+      TieredFunction function;
+      {
+         std::lock_guard<std::mutex> lock(tieredFunctionsMutex_);
+         function = tieredFunctions_[id];
+      }
+      
+      // removed while the request was waiting
+      if (!function.module || function.tracker->isDefunct())
+         return;
+      
+      // the function alone, what it calls is declared and resolved to the stubs
+      auto module = llvm::orc::cloneToNewContext(*function.module, [&](const llvm::GlobalValue& value) {
+         return value.getName() == function.name;
+      });
+      
+      auto error = module.withModuleDo([&](llvm::Module& m) -> llvm::Error {
+         // the recursive calls stay in tier 1
+         m.getFunction(function.name)->setName(bodyName(function.name, Tier1Suffix, id));
+         tierUpOptimizer_.optimizeModule(m);
+         
+         auto object = llvm::orc::SimpleCompiler(*tierUpMachine_, tierUpObjectCache_.get())(m);
+         if (!object)
+            return object.takeError();
+         
+         // with its tier 0: removing the module frees both
+         return jit_->addObjectFile(function.tracker, std::move(*object));
+      });
+      if (error)
+      {
+         // defined again meanwhile
+         if (function.tracker->isDefunct())
+            llvm::consumeError(std::move(error));
+         else
+            reportError(std::move(error));
+         return;
+      }
+      
+      auto body = jit_->lookup(bodyName(function.name, Tier1Suffix, id));
+      if (!body)
+      {
+         reportError(body.takeError());
+         return;
+      }
+      
+      // unless defined again meanwhile: the stub belongs to the new definition then
+      std::lock_guard<std::mutex> lock(tieredFunctionsMutex_);
+      if (!tieredFunctions_[id].module)
+         return;
+      
+      if (auto error = stubs_->updatePointer(function.name, body->getAddress()))
+      {
+         reportError(std::move(error));
+         return;
+      }
+      
+      ++tierUpCount_;
    }
    
-   void JIT::removeModule(ModuleHandle H) {
-      //cantFail(compileLayer_.removeModule(H));
-      cantFail(optimizeLayer_.removeModule(H));
+   llvm::JITSymbol JIT::findSymbol(const std::string& name)
+   {
+      auto jit = getJIT();
+      if (!jit)
+         return nullptr;
+      
+      auto symbol = jit->lookup(name);
+      if (!symbol)
+      {
+         reportError(symbol.takeError());
+         return nullptr;
+      }
+      
+      return *symbol;
    }
    
-   std::shared_ptr<llvm::Module> JIT::optimizeModule(std::shared_ptr<llvm::Module> module)
+   llvm::JITTargetAddress JIT::getSymbolAddress(const std::string& name)
    {
-      // Create a function pass manager.
-      auto functionPassManager = llvm::make_unique<llvm::legacy::FunctionPassManager>(module.get());
+      if (auto symbol = findSymbol(name))
+         return llvm::cantFail(symbol.getAddress());
       
-      // Add some optimizations.
-      functionPassManager->add(llvm::createInstructionCombiningPass());
-      functionPassManager->add(llvm::createReassociatePass());
-      functionPassManager->add(llvm::createNewGVNPass());
-      functionPassManager->add(llvm::createCFGSimplificationPass());
-      functionPassManager->doInitialization();
+      return 0;
+   }
+   
+   void JIT::removeModule(ModuleHandle moduleHandle)
+   {
+      if (!moduleHandle)
+         return;
       
-      // Run the optimizations over all functions in the module being added to
-      // the JIT.
-      for (auto &function : *module)
-         functionPassManager->run(function);
+      // the functions it defined are gone, their stubs wait for the next definitions
+      for (auto function = stubbedFunctions_.begin(); function != stubbedFunctions_.end();)
+      {
+         if (function->second.module != moduleHandle)
+         {
+            ++function;
+            continue;
+         }
          
-         return module;
+         releaseModule(function->second.symbol);
+         function = stubbedFunctions_.erase(function);
+      }
+      
+      releaseModule(moduleHandle);
+   }
+   
+   void JIT::releaseModule(ModuleHandle moduleHandle)
+   {
+      // tier 1 is not asked for, nor installed, for a module removed
+      if (mode_ == CompileMode::Tiered)
+      {
+         std::lock_guard<std::mutex> lock(tieredFunctionsMutex_);
+         for (auto& function : tieredFunctions_)
+         {
+            if (function.tracker == moduleHandle)
+               function = TieredFunction{function.name, nullptr, nullptr};
+         }
+      }
+      
+      if (auto error = moduleHandle->remove())
+         reportError(std::move(error));
    }
 }
-
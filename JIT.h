@@ -14,48 +14,229 @@
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
-#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
-#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
-#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
-#include "llvm/ExecutionEngine/ExecutionEngine.h"
-#include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/ThreadPool.h"
 
+#include "ObjectCache.h"
+#include "Optimizer.h"
+
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace jit
 {
+   ///
+   /// @brief: how the functions of a module are compiled.
+   ///         Eager  when the module is added (or on the first lookup with no compile thread)
+   ///         Lazy   each one on its first call
+   ///         Tiered at once without optimization (tier 0), again optimized once called often (tier 1)
+   ///
+   enum class CompileMode
+   {
+      Eager,
+      Lazy,
+      Tiered
+   };
+   
+   ///
+   /// @brief: jit compiler of the session, an ORC LLJIT. Modules come in already optimized (see
+   ///         optimizer::Optimizer) as ThreadSafeModules, each with a context of its own, and are
+   ///         compiled on a pool of compile threads: addModule starts the compilation of what the
+   ///         module defines and returns, the parser goes on with the next item while the pool
+   ///         works. A lookup waits for the symbol to be compiled.
+   ///         With no compile thread modules are compiled on the calling thread, on lookup.
+   ///         In lazy mode (an LLLazyJIT) nothing is compiled when a module is added: every function
+   ///         gets a stub, and the first call through it compiles the body of that function alone.
+   ///         In tiered mode modules come in unoptimized and are compiled at once with the fast
+   ///         instruction selector. Every function is called through a stub and counts its calls:
+   ///         the one reaching the threshold is optimized and compiled again, from the IR it had
+   ///         when added, on a thread of its own, then its stub is pointed to the new code.
+   ///         With redefinition on, the functions of the modules added are called through stubs in
+   ///         every mode, and a module can define a name again: it replaces the module defining it.
+   ///         The stubs are not freed: the stub of a function whose module is removed is used again
+   ///         by the next definition of the same name.
+   ///         The process symbols (the runtime of the language) are visible to the modules
+   ///
    class JIT
    {
+   public:
+      
+      ///
+      /// @brief: a module in the jit, removing the handle removes the module (nullptr if the
+      ///         module could not be added)
+      ///
+      using ModuleHandle = llvm::orc::ResourceTrackerSP;
       
    private:
       
+      ///
+      /// @brief: a function of the tiered mode, with the module it comes from as it was added
+      ///         (nullptr once removed) and the tracker both its tiers belong to
+      ///
+      struct TieredFunction
+      {
+         std::string name;
+         std::shared_ptr<llvm::orc::ThreadSafeModule> module;
+         ModuleHandle tracker;
+      };
+      
+      ///
+      /// @brief: a function called through a stub: the tracker of the symbol of its stub, and the
+      ///         one of the module defining it now. The module can be replaced, the symbol stays
+      ///
+      struct StubbedFunction
+      {
+         ModuleHandle symbol;
+         ModuleHandle module;
+      };
+      
       std::unique_ptr<llvm::TargetMachine> targetMachine_;
       llvm::DataLayout dataLayout_;
-      llvm::orc::RTDyldObjectLinkingLayer objectLayer_;
-      using CompileLayer = llvm::orc::IRCompileLayer<decltype(objectLayer_), llvm::orc::SimpleCompiler>;
-      CompileLayer compileLayer_;
       
+      //object cache, before the jit that uses it on its compile threads
+      bool objectCacheEnabled_;
+      std::string objectCacheDirectory_;
+      std::uint64_t objectCacheSize_;
+      std::unique_ptr<ObjectCache> objectCache_;
+      std::unique_ptr<ObjectCache> tierUpObjectCache_; //same directory, the target of tier 1 differs
       
-      //embedded optimization inside the jit compiler
-      using OptimizeFunction = std::function<std::shared_ptr<llvm::Module>(std::shared_ptr<llvm::Module>)>;
-      llvm::orc::IRTransformLayer<decltype(compileLayer_), OptimizeFunction> optimizeLayer_;
+      std::unique_ptr<llvm::orc::LLJIT> jit_;
+      unsigned compileThreads_;
+      CompileMode mode_;
+      std::function<void(llvm::Module&)> transform_;
+      bool redefinition_;
       
-   private:
+      //tiered mode and redefinition
+      std::unique_ptr<llvm::orc::IndirectStubsManager> stubs_;
+      std::map<std::string, StubbedFunction> stubbedFunctions_; //by name
+      std::uint64_t stubbedModules_; //numbers the bodies out of the tiered mode
       
-      std::shared_ptr<llvm::Module> optimizeModule(std::shared_ptr<llvm::Module> module);
+      //tiered mode
+      std::unique_ptr<llvm::TargetMachine> tierUpMachine_;
+      optimizer::Optimizer tierUpOptimizer_;
+      std::uint64_t tierUpThreshold_;
+      std::vector<TieredFunction> tieredFunctions_; //indexed by the id passed to tierUp
+      std::mutex tieredFunctionsMutex_;
+      std::atomic<std::size_t> tierUpCount_;
+      std::unique_ptr<llvm::ThreadPool> tierUpThread_; //last, its tasks use the rest
       
-   public:
+      llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> createJIT();
+      
+      ///
+      /// @brief: a module whose functions are called through stubs, compiled now, or on the first
+      ///         call in lazy mode. In tiered mode it is tier 0: a counter at the entry of every
+      ///         function. The module it replaces is removed once it is compiled: a module that
+      ///         fails leaves the old one in place (in lazy mode, only a failure found when added)
+      ///
+      ModuleHandle addStubbedModule(llvm::orc::ThreadSafeModule module);
+      void instrument(llvm::Module& module, llvm::Function& function, std::uint64_t id);
       
-      using ModuleHandle = decltype(compileLayer_)::ModuleHandleT;
+      ///
+      /// @brief: remove a module, its stubs are left for the next definitions of its functions
+      ///
+      void releaseModule(ModuleHandle moduleHandle);
+      
+      ///
+      /// @brief: tier 1 of a function, called by the function itself when its counter reaches the threshold
+      ///
+      static void tierUpEntry(std::uint64_t jit, std::uint64_t id);
+      void tierUp(std::uint64_t id);
+      void recompile(std::uint64_t id);
+      
+      ///
+      /// @brief: the LLJIT is built on first use, once the number of compile threads is known
+      ///
+      llvm::orc::LLJIT* getJIT();
+      
+   public:
       
       explicit JIT();
-      llvm::EngineBuilder engineBuilder_;
+      ~JIT();
+      
+      ///
+      /// @brief: machine of the host, the one the modules are compiled for. The compile threads
+      ///         have their own copy, this one only answers queries (data layout, cost models)
+      ///
       llvm::TargetMachine &getTargetMachine() const;
-      ModuleHandle addModule(std::unique_ptr<llvm::Module>& module);
+      
+      ///
+      /// @brief: number of compile threads, 0 compiles on the thread looking up a symbol.
+      ///         Taken into account until the first module is added
+      ///
+      void setCompileThreads(unsigned compileThreads);
+      unsigned getCompileThreads() const;
+      
+      ///
+      /// @brief: when the functions are compiled (Eager by default).
+      ///         Taken into account until the first module is added
+      ///
+      void setCompileMode(CompileMode mode);
+      CompileMode getCompileMode() const;
+      
+      ///
+      /// @brief: tiered mode, calls after which a function is optimized (1000 by default), and the
+      ///         optimizer of tier 1 (O2 by default, its policy stays PerModule)
+      ///
+      void setTierUpThreshold(std::uint64_t calls);
+      optimizer::Optimizer& getTierUpOptimizer();
+      
+      ///
+      /// @brief: keep the compiled objects in directory (the user cache directory if empty), at most
+      ///         maxSize bytes, and reuse them in the sessions that follow (see jit::ObjectCache).
+      ///         Taken into account until the first module is added
+      ///
+      void setObjectCache(std::string directory, std::uint64_t maxSize);
+      
+      ///
+      /// @brief: modules whose object came from the cache, and modules compiled with the cache on
+      ///
+      std::size_t getObjectCacheHitCount() const;
+      std::size_t getObjectCacheMissCount() const;
+      
+      ///
+      /// @brief: functions whose tier 1 replaced their tier 0 so far
+      ///
+      std::size_t getTierUpCount() const;
+      
+      ///
+      /// @brief: return once the tier ups asked for so far are done
+      ///
+      void waitForTierUps();
+      
+      ///
+      /// @brief: run on every module right before it is compiled, on a compile thread if there
+      ///         are any. In lazy mode the modules are the single functions being compiled.
+      ///         Taken into account until the first module is added
+      ///
+      void setModuleTransform(std::function<void(llvm::Module&)> transform);
+      
+      ///
+      /// @brief: let the modules added from now on define again the functions of the modules added
+      ///         the same way (off by default, the REPL turns it on). A function is defined again
+      ///         by a module replacing the whole module defining it, which is removed; the callers
+      ///         compiled before reach the new code through the stub. In lazy mode the stub leads
+      ///         to the one of the compile on demand layer, the body is still compiled on its first
+      ///         call. The functions of a module added with it off stay defined once
+      ///
+      void setRedefinition(bool enable);
+      
+      ///
+      /// @brief: add a module, compiled as the mode says or, with compileNow, as in the eager mode:
+      ///         for the modules run at once and removed (stubs outlive their module)
+      ///
+      ModuleHandle addModule(llvm::orc::ThreadSafeModule module, bool compileNow = false);
       llvm::JITSymbol findSymbol(const std::string& name);
       llvm::JITTargetAddress getSymbolAddress(const std::string& name);
-      void removeModule(ModuleHandle moduleHandle);      
+      void removeModule(ModuleHandle moduleHandle);
       
    };
 }
@@ -0,0 +1,187 @@
+//
+//  JITTest.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 16/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+//  JIT tests: functions are defined, defined again and called through their stubs, the value
+//  returned is compared with the one expected, in lazy mode the bodies compiled too. Prints the
+//  cases that fail, exits with 1 if any does.
+//
+//  usage: jittest.out
+//
+
+#include "JIT.h"
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+   ///
+   /// @brief: a module defining name(x), which returns value. With a callee, it returns
+   ///         value + callee(x) and callee is declared, resolved when the module is compiled
+   ///
+   llvm::orc::ThreadSafeModule define(jit::JIT& jit, const std::string& name, double value, const std::string& callee = "")
+   {
+      auto context = std::make_unique<llvm::LLVMContext>();
+      auto module = std::make_unique<llvm::Module>(name, *context);
+      module->setDataLayout(jit.getTargetMachine().createDataLayout());
+
+      llvm::IRBuilder<> builder(*context);
+      auto type = llvm::FunctionType::get(builder.getDoubleTy(), {builder.getDoubleTy()}, false);
+      auto function = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, module.get());
+      builder.SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", function));
+
+      llvm::Value* result = llvm::ConstantFP::get(builder.getDoubleTy(), value);
+      if (!callee.empty())
+      {
+         auto declared = module->getOrInsertFunction(callee, type);
+         result = builder.CreateFAdd(result, builder.CreateCall(declared, {&*function->arg_begin()}));
+      }
+      builder.CreateRet(result);
+
+      return llvm::orc::ThreadSafeModule(std::move(module), std::move(context));
+   }
+
+   ///
+   /// @brief: the function name called through its stub, NaN when it is not defined
+   ///
+   double call(jit::JIT& jit, const std::string& name, double x)
+   {
+      auto address = jit.getSymbolAddress(name);
+      if (!address)
+         return std::numeric_limits<double>::quiet_NaN();
+
+      return reinterpret_cast<double (*)(double)>(address)(x);
+   }
+
+   bool expect(const char* test, const char* what, double value, double expected)
+   {
+      if (value == expected)
+         return true;
+
+      std::cerr << "Error: " << test << ": " << what << " is " << value << ", " << expected << " expected\n";
+      return false;
+   }
+
+   ///
+   /// @brief: a definition that does not compile leaves the one it replaces in place
+   ///
+   bool failedRedefinition(jit::CompileMode mode)
+   {
+      jit::JIT jit;
+      jit.setCompileMode(mode);
+      jit.setRedefinition(true);
+
+      const char* test = mode == jit::CompileMode::Tiered ? "failed redefinition (tiered)" : "failed redefinition (eager)";
+      if (!jit.addModule(define(jit, "f", 1)))
+         return expect(test, "first definition", 0, 1);
+
+      // __undefined is resolved nowhere
+      std::cerr << "(an error about __undefined is expected)\n";
+      if (jit.addModule(define(jit, "f", 2, "__undefined")))
+         return expect(test, "failing definition", 1, 0);
+
+      if (!expect(test, "f(0) after the failure", call(jit, "f", 0), 1))
+         return false;
+
+      if (!jit.addModule(define(jit, "f", 3)))
+         return expect(test, "second definition", 0, 1);
+      return expect(test, "f(0) defined again", call(jit, "f", 0), 3);
+   }
+
+   ///
+   /// @brief: a function defined again is called by the functions defined before it
+   ///
+   bool redefinition(jit::CompileMode mode)
+   {
+      jit::JIT jit;
+      jit.setCompileMode(mode);
+      jit.setRedefinition(true);
+
+      const char* test = mode == jit::CompileMode::Tiered ? "redefinition (tiered)"
+                       : mode == jit::CompileMode::Lazy ? "redefinition (lazy)" : "redefinition (eager)";
+      if (!jit.addModule(define(jit, "f", 1)) || !jit.addModule(define(jit, "g", 10, "f")))
+         return expect(test, "definitions", 0, 1);
+      if (!expect(test, "g(0)", call(jit, "g", 0), 11))
+         return false;
+
+      if (!jit.addModule(define(jit, "f", 2)))
+         return expect(test, "definition again", 0, 1);
+      return expect(test, "g(0) after f is defined again", call(jit, "g", 0), 12);
+   }
+
+   ///
+   /// @brief: in lazy mode a body, first or new definition, is compiled on its first call
+   ///
+   bool lazyCompilation(jit::CompileMode mode)
+   {
+      std::vector<std::string> compiled; //bodies, in the order they are compiled
+      jit::JIT jit;
+      jit.setCompileMode(mode);
+      jit.setRedefinition(true);
+      jit.setModuleTransform([&](llvm::Module& m) {
+         for (const auto& function : m)
+         {
+            if (!function.isDeclaration())
+               compiled.push_back(function.getName().str());
+         }
+      });
+
+      const char* test = "lazy compilation";
+      if (!jit.addModule(define(jit, "f", 1)) || !jit.addModule(define(jit, "g", 10, "f")))
+         return expect(test, "definitions", 0, 1);
+      if (!expect(test, "bodies compiled before the first call", compiled.size(), 0) ||
+          !expect(test, "g(0)", call(jit, "g", 0), 11) ||
+          !expect(test, "bodies compiled by g(0)", compiled.size(), 2))
+         return false;
+
+      if (!jit.addModule(define(jit, "f", 2)))
+         return expect(test, "definition again", 0, 1);
+      return expect(test, "bodies compiled before the call to f defined again", compiled.size(), 2) &&
+             expect(test, "g(0) after f is defined again", call(jit, "g", 0), 12) &&
+             expect(test, "bodies compiled by g(0)", compiled.size(), 3);
+   }
+
+   using Test = bool (*)(jit::CompileMode);
+
+   struct Case
+   {
+      Test test;
+      jit::CompileMode mode;
+   };
+
+   const Case Cases[] = {
+      {redefinition, jit::CompileMode::Eager},
+      {redefinition, jit::CompileMode::Tiered},
+      {redefinition, jit::CompileMode::Lazy},
+      {lazyCompilation, jit::CompileMode::Lazy},
+      {failedRedefinition, jit::CompileMode::Eager},
+      {failedRedefinition, jit::CompileMode::Tiered},
+   };
+}
+
+int main()
+{
+   llvm::InitializeNativeTarget();
+   llvm::InitializeNativeTargetAsmPrinter();
+
+   std::size_t failed = 0;
+   for (const auto& test : Cases)
+   {
+      if (!test.test(test.mode))
+         ++failed;
+   }
+
+   std::cout << sizeof(Cases) / sizeof(Cases[0]) - failed << " passed, " << failed << " failed\n";
+   return failed == 0 ? 0 : 1;
+}
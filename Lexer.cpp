@@ -7,95 +7,250 @@
 //
 
 #include "Lexer.h"
+#include "NumberScanner.h"
+#include "ScanKernels.h"
 
 #include <cctype>
-#include <cstdlib>
+#include <cstring>
 
 namespace lexer
 {
-   Lexer::Lexer(/*debug::DebugInfo& debug*/) /*:
-   debug_(debug)*/
-   {}
-   
-   int Lexer::gettok()
+   namespace
    {
+      ///
+      /// keyword recognition: a perfect hash on (first char, last char, length) computed at compile time.
+      /// New keywords are added to the table below, the static_assert reports a collision if the hash
+      /// has to be tuned for them
+      ///
+      struct Keyword
+      {
+         const char* spelling;
+         std::size_t length;
+         Token token;
+      };
+      
+      constexpr Keyword keywords[] = {
+         {"def",    3, tok_def},
+         {"extern", 6, tok_extern},
+         {"if",     2, tok_if},
+         {"then",   4, tok_then},
+         {"else",   4, tok_else},
+         {"for",    3, tok_for},
+         {"in",     2, tok_in},
+         {"unary",  5, tok_unary},
+         {"binary", 6, tok_binary},
+         {"var",    3, tok_var}
+      };
       
-      static int LastChar = ' ';
+      constexpr std::size_t keywordCount = sizeof(keywords) / sizeof(keywords[0]);
+      constexpr std::size_t keywordSlots = 32;
       
-      // Skip any whitespace.
-      while (isspace(LastChar)) {
-         LastChar = advance();
+      constexpr std::size_t keywordHash(unsigned char first, unsigned char last, std::size_t length)
+      {
+         return (first + last + 2 * length) & (keywordSlots - 1);
       }
       
-      //debug_.currentLocation_ = debug_.currentLexerLocation_;
+      struct KeywordTable
+      {
+         signed char slot[keywordSlots];
+         std::size_t minLength;
+         std::size_t maxLength;
+         bool perfect;
+      };
       
-      if (isalpha(LastChar)) {
-         // identifier: [a-zA-Z][a-zA-Z0-9]*
-         identifierStr_ = LastChar;
-         while (isalnum((LastChar = getchar())))
+      constexpr KeywordTable buildKeywordTable()
+      {
+         KeywordTable table = {};
+         table.minLength = keywords[0].length;
+         table.maxLength = keywords[0].length;
+         table.perfect = true;
+         
+         for (std::size_t i = 0; i < keywordSlots; ++i)
+            table.slot[i] = -1;
+         
+         for (std::size_t i = 0; i < keywordCount; ++i)
          {
-            identifierStr_ += LastChar;
+            const auto& k = keywords[i];
+            auto h = keywordHash(k.spelling[0], k.spelling[k.length - 1], k.length);
+            if (table.slot[h] != -1)
+               table.perfect = false;
+            
+            table.slot[h] = static_cast<signed char>(i);
+            table.minLength = k.length < table.minLength ? k.length : table.minLength;
+            table.maxLength = k.length > table.maxLength ? k.length : table.maxLength;
          }
          
-         if (identifierStr_ == "def")
-            return tok_def;
-         if (identifierStr_ == "extern")
-            return tok_extern;
-         if (identifierStr_ == "if")
-            return tok_if;
-         if (identifierStr_ == "then")
-            return tok_then;
-         if (identifierStr_ == "else")
-            return tok_else;
-         if(identifierStr_ == "for")
-            return tok_for;
-         if(identifierStr_ == "in")
-            return tok_in;
-         if(identifierStr_ == "unary")
-            return tok_unary;
-         if(identifierStr_ == "binary")
-            return tok_binary;
-         if (identifierStr_ == "var")
-            return tok_var;
-         
-         return tok_identifier;
+         return table;
       }
       
-      if (isdigit(LastChar) || LastChar == '.') {
-         
-         // Number: [0-9.]+
-         std::string NumStr;
-         do
-         {
-            NumStr += LastChar;
-            LastChar = getchar();
-         } while (isdigit(LastChar) || LastChar == '.');
-         
-         numVal_ = strtod(NumStr.c_str(), nullptr);
-         return tok_number;
+      constexpr KeywordTable keywordTable = buildKeywordTable();
+      static_assert(keywordTable.perfect, "keyword hash collision: tune keywordHash()");
+      
+      ///
+      /// @brief: c marks the exponent of the literal starting at literal, which reaches c: [eE] in a
+      ///         decimal literal, [pP] in a hex one (where 'e' is a digit)
+      ///
+      inline bool isExponentMarker(const char* literal, char c)
+      {
+         bool hex = literal[0] == '0' && (literal[1] | 0x20) == 'x';
+         return (c | 0x20) == (hex ? 'p' : 'e');
       }
+   }
+   
+   int classifyIdentifier(const char* s, std::size_t length)
+   {
+      if (length < keywordTable.minLength || length > keywordTable.maxLength)
+         return tok_identifier;
       
+      auto i = keywordTable.slot[keywordHash(s[0], s[length - 1], length)];
+      if (i < 0 || keywords[i].length != length || std::memcmp(keywords[i].spelling, s, length) != 0)
+         return tok_identifier;
+      
+      return keywords[i].token;
+   }
+   
+   Lexer::Lexer(util::Interner& interner, std::unique_ptr<InputSource> source /*, debug::DebugInfo& debug*/) :
+   source_(std::move(source)),
+   cur_(source_->begin()),
+   end_(source_->end()),
+   lastChar_(' '),
+   windowOffset_(0),
+   tokenOffset_(0),
+   interner_(interner),
+   numVal_(0)
+   /*debug_(debug)*/
+   {}
+   
+   void Lexer::reset(std::unique_ptr<InputSource> source)
+   {
+      source_ = std::move(source);
+      cur_ = source_->begin();
+      end_ = source_->end();
+      lastChar_ = ' ';
+      windowOffset_ = 0;
+      tokenOffset_ = 0;
+      identifier_ = util::Symbol();
+      numVal_ = 0;
+   }
+   
+   bool Lexer::refill(const char*& keep)
+   {
+      auto scanned = cur_ - keep;
+      windowOffset_ += keep - source_->begin();
+      bool more = source_->refill(keep);
       
-      if (LastChar == '#') {
-         // Comment until end of line.
-         do
+      keep = source_->begin();
+      cur_ = keep + scanned;
+      end_ = source_->end();
+      return more;
+   }
+   
+   template <typename Kernel>
+   void Lexer::skipRun(const char*& start, Kernel kernel)
+   {
+      while (true)
+      {
+         cur_ = kernel(cur_, end_);
+         if (cur_ != end_ || !refill(start))
+            return;
+      }
+   }
+   
+   template <typename Kernel>
+   void Lexer::discardRun(Kernel kernel)
+   {
+      while (true)
+      {
+         cur_ = kernel(cur_, end_);
+         
+         // nothing scanned so far has to be preserved
+         const char* keep = cur_;
+         if (cur_ != end_ || !refill(keep))
+            return;
+      }
+   }
+   
+   int Lexer::gettok()
+   {
+      while (true)
+      {
+         // Skip any whitespace.
+         if (isspace(lastChar_))
+         {
+            discardRun(skipWhitespace);
+            lastChar_ = advance();
+         }
+         
+         //debug_.currentLocation_ = debug_.currentLexerLocation_;
+         
+         if (isalpha(lastChar_)) {
+            // identifier: [a-zA-Z][a-zA-Z0-9]*
+            // lastChar_ has just been consumed from the window, the token starts one byte behind
+            const char* start = cur_ - 1;
+            tokenOffset_ = offsetOf(start);
+            skipRun(start, skipIdentifier);
+            
+            // keywords carry no payload, only identifiers are looked up in the interner
+            auto token = classifyIdentifier(start, cur_ - start);
+            if (token == tok_identifier)
+               identifier_ = interner_.intern(llvm::StringRef(start, cur_ - start));
+            
+            lastChar_ = advance();
+            return token;
+         }
+         
+         if (isdigit(lastChar_) || lastChar_ == '.') {
+            
+            // Number: the whole run that could belong to the literal is taken (as a C pp-number)
+            // and then validated, so that 1.2.3 or 4x are reported instead of being split
+            const char* start = cur_ - 1;
+            tokenOffset_ = offsetOf(start);
+            skipRun(start, [&start](const char* p, const char* end) {
+               while (true)
+               {
+                  p = skipNumber(p, end);
+                  
+                  // a sign right after an exponent marker continues the literal, 0xe+1 is a sum
+                  if (p == end || (*p != '+' && *p != '-') || !isExponentMarker(start, p[-1]))
+                     return p;
+                  ++p;
+               }
+            });
+            
+            bool valid = parseNumber(start, cur_, numVal_);
+            if (!valid)
+               error_.assign("malformed number literal '").append(start, cur_).append("'");
+            
+            lastChar_ = advance();
+            if (!valid)
+               return tok_error;
+            
+            return tok_number;
+         }
+         
+         
+         if (lastChar_ == '#') {
+            // Comment until end of line, then look for the next token.
+            discardRun(findLineEnd);
+            lastChar_ = advance();
+            
+            if (lastChar_ != EOF)
+               continue;
+         }
+         
+         // Check for end of file.  Don't eat the EOF.
+         if (lastChar_ == EOF)
          {
-            LastChar = getchar();
-         }while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
+            tokenOffset_ = offsetOf(cur_);
+            return tok_eof;
+         }
          
-         if (LastChar != EOF)
-            return gettok();
+         // Otherwise, just return the character as its ascii value.
+         int ThisChar = lastChar_;
+         tokenOffset_ = offsetOf(cur_ - 1);
+         lastChar_ = advance();
+         return ThisChar;
       }
-      
-      // Check for end of file.  Don't eat the EOF.
-      if (LastChar == EOF)
-         return tok_eof;
-      
-      // Otherwise, just return the character as its ascii value.
-      int ThisChar = LastChar;
-      LastChar = advance();
-      return ThisChar;
-     
    }
    
    double Lexer::getNum() const
@@ -103,14 +258,36 @@ namespace lexer
       return numVal_;
    }
    
-   std::string Lexer::getId() const
+   util::Symbol Lexer::getId() const
+   {
+      return identifier_;
+   }
+   
+   const std::string& Lexer::getError() const
    {
-      return identifierStr_;
+      return error_;
+   }
+   
+   std::size_t Lexer::getTokenOffset() const
+   {
+      return tokenOffset_;
+   }
+   
+   std::size_t Lexer::offsetOf(const char* p) const
+   {
+      return windowOffset_ + (p - source_->begin());
    }
    
    int Lexer::advance()
    {
-      int LastChar = getchar();
+      if (cur_ == end_)
+      {
+         const char* keep = cur_;
+         if (!refill(keep))
+            return EOF;
+      }
+      
+      int LastChar = static_cast<unsigned char>(*cur_++);
       
 //      if (LastChar == '\n' || LastChar == '\r')
 //      {
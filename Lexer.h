@@ -9,8 +9,11 @@
 #ifndef Lexer_h
 #define Lexer_h
 
+#include <memory>
 #include <string>
 #include "Debug.h"
+#include "InputSource.h"
+#include "Interner.h"
 
 namespace lexer
 {
@@ -46,35 +49,92 @@ namespace lexer
       tok_binary = -12,
       
       //variable definition
-      tok_var = -13
+      tok_var = -13,
+      
+      //malformed input, see Lexer::getError()
+      tok_error = -14
 
    };
    
+   ///
+   /// @brief: the keyword token the identifier [s, s+length) spells, tok_identifier if none
+   ///
+   int classifyIdentifier(const char* s, std::size_t length);
+   
    
    class Lexer {
       
    public:
       
-      Lexer(/*debug::DebugInfo& debug*/);
+      explicit Lexer(util::Interner& interner,
+                     std::unique_ptr<InputSource> source = createStdinInputSource() /*, debug::DebugInfo& debug*/);
       
       /**
        * @brief: tokenize my input.
-       *         Reading from std::input a single char and recongnise the basic tokens of the language
+       *         Scan the window exposed by the input source and recongnise the basic tokens of the language
        */
       int gettok();
       
       double getNum() const;
-      std::string getId() const;
+      
+      ///
+      /// @brief: last identifier scanned, interned in the interner of the lexer
+      ///
+      util::Symbol getId() const;
+      
+      ///
+      /// @brief: description of the last tok_error returned
+      ///
+      const std::string& getError() const;
+      
+      ///
+      /// @brief: offset from the beginning of the input of the first byte of the last token returned
+      ///
+      std::size_t getTokenOffset() const;
+      
+      ///
+      /// @brief: restart tokenizing from a new input, dropping any lookahead of the previous one
+      ///
+      void reset(std::unique_ptr<InputSource> source);
       
       
    private:
-      std::string identifierStr_;
+      std::unique_ptr<InputSource> source_;
+      const char* cur_; //next byte to scan in the source window
+      const char* end_;
+      int lastChar_; //lookahead character, already consumed from the window
+      std::size_t windowOffset_; //offset in the input of the first byte of the window
+      std::size_t tokenOffset_;
+      
+      util::Interner& interner_;
+      util::Symbol identifier_;
       double numVal_;
+      std::string error_;
       //debug::DebugInfo& debug_;
       
       
       int advance();
       
+      std::size_t offsetOf(const char* p) const;
+      
+      ///
+      /// @brief: slide the source window, preserving the bytes from keep onwards. keep and cur_ are rebased
+      ///
+      bool refill(const char*& keep);
+      
+      ///
+      /// @brief: move cur_ to the end of the run found by kernel (see ScanKernels.h), refilling the
+      ///         window if needed. The bytes from start onwards stay contiguous in the window
+      ///
+      template <typename Kernel>
+      void skipRun(const char*& start, Kernel kernel);
+      
+      ///
+      /// @brief: as skipRun, for runs that are thrown away (whitespace, comments)
+      ///
+      template <typename Kernel>
+      void discardRun(Kernel kernel);
+      
    };
    
    
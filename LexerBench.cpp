@@ -0,0 +1,211 @@
+//
+//  LexerBench.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 16/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+//  Lexer microbenchmark: tokenizes an identifier heavy input, keywords mixed with identifiers of
+//  every length, and reports the throughput of gettok(). Then classifies the identifiers of the
+//  input through lexer::classifyIdentifier() against the chain of std::string comparisons the
+//  lexer used before, the identifier copied out first as it did.
+//
+//  usage: lexerbench.out [megabytes] [passes]   (default 24 MB, 5 passes)
+//         lexerbench.out --file=<path> [passes]
+//
+
+#include "InputSource.h"
+#include "Interner.h"
+#include "Lexer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+   using milliseconds_t = std::chrono::duration<double, std::milli>;
+   using identifier_t = std::pair<const char*, std::size_t>;
+
+   const char* const Words[] = {
+      "def", "extern", "if", "then", "else", "for", "in", "binary", "unary", "var",
+      "x", "y", "n", "fib", "counter", "definition", "iffy", "thenceforth", "variable", "extern2",
+      "accumulate", "inrange", "binaryop", "printd", "putchard", "LHS", "RHS", "step", "start", "end"
+   };
+
+   ///
+   /// @brief: megabytes of words separated by blanks and newlines, the same for every run
+   ///
+   std::string generate(std::size_t megabytes)
+   {
+      std::mt19937 random(2017);
+      std::uniform_int_distribution<std::size_t> word(0, sizeof(Words) / sizeof(Words[0]) - 1);
+      std::uniform_int_distribution<int> line(0, 11);
+
+      std::string text;
+      text.reserve(megabytes << 20);
+      while (text.size() < (megabytes << 20))
+      {
+         text += Words[word(random)];
+         text += line(random) == 0 ? '\n' : ' ';
+      }
+      return text;
+   }
+
+   bool readFile(const std::string& path, std::string& text)
+   {
+      std::ifstream in(path, std::ios::binary);
+      if (!in)
+         return false;
+      text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+      return true;
+   }
+
+   ///
+   /// @brief: the identifiers of text, [a-zA-Z][a-zA-Z0-9]* as the lexer scans them
+   ///
+   std::vector<identifier_t> split(const std::string& text)
+   {
+      std::vector<identifier_t> identifiers;
+      for (std::size_t i = 0; i < text.size();)
+      {
+         if (!isalpha(static_cast<unsigned char>(text[i])))
+         {
+            ++i;
+            continue;
+         }
+
+         auto start = i;
+         while (i < text.size() && isalnum(static_cast<unsigned char>(text[i])))
+            ++i;
+         identifiers.emplace_back(text.data() + start, i - start);
+      }
+      return identifiers;
+   }
+
+   ///
+   /// @brief: the keyword recognition of the lexer before the perfect hash
+   ///
+   int classifyByComparison(std::string& identifierStr, const char* s, std::size_t length)
+   {
+      identifierStr.assign(s, length);
+      if (identifierStr == "def")
+         return lexer::tok_def;
+      if (identifierStr == "extern")
+         return lexer::tok_extern;
+      if (identifierStr == "if")
+         return lexer::tok_if;
+      if (identifierStr == "then")
+         return lexer::tok_then;
+      if (identifierStr == "else")
+         return lexer::tok_else;
+      if (identifierStr == "for")
+         return lexer::tok_for;
+      if (identifierStr == "in")
+         return lexer::tok_in;
+      if (identifierStr == "unary")
+         return lexer::tok_unary;
+      if (identifierStr == "binary")
+         return lexer::tok_binary;
+      if (identifierStr == "var")
+         return lexer::tok_var;
+      return lexer::tok_identifier;
+   }
+
+   ///
+   /// @brief: every identifier classified passes times, returns the best time
+   ///
+   template <typename Classify>
+   double timeClassify(Classify classify, const std::vector<identifier_t>& identifiers, int passes, long& checksum)
+   {
+      double best = 0;
+      for (int pass = 0; pass < passes; ++pass)
+      {
+         long sum = 0;
+         auto start = std::chrono::steady_clock::now();
+         for (const auto& identifier : identifiers)
+            sum += classify(identifier.first, identifier.second);
+         milliseconds_t elapsed = std::chrono::steady_clock::now() - start;
+
+         checksum = sum;
+         if (pass == 0 || elapsed.count() < best)
+            best = elapsed.count();
+      }
+      return best;
+   }
+}
+
+int main(int argc, const char* argv[])
+{
+   std::string text;
+   int next = 1;
+   if (argc > 1 && std::string(argv[1]).compare(0, 7, "--file=") == 0)
+   {
+      if (!readFile(argv[1] + 7, text))
+      {
+         std::cerr << "Error: cannot read " << argv[1] + 7 << "\n";
+         return 1;
+      }
+      ++next;
+   }
+   else
+   {
+      auto megabytes = argc > next ? std::strtoul(argv[next++], nullptr, 10) : 24;
+      text = generate(megabytes ? megabytes : 1);
+   }
+   int passes = argc > next ? std::max(1, std::atoi(argv[next])) : 5;
+
+   util::Interner interner;
+   lexer::Lexer lexer(interner, std::make_unique<lexer::StringInputSource>(text));
+
+   std::size_t tokens = 0;
+   double best = 0;
+   for (int pass = 0; pass < passes; ++pass)
+   {
+      lexer.reset(std::make_unique<lexer::StringInputSource>(text));
+
+      auto start = std::chrono::steady_clock::now();
+      std::size_t count = 0;
+      for (int token = lexer.gettok(); token != lexer::tok_eof; token = lexer.gettok())
+         ++count;
+      milliseconds_t elapsed = std::chrono::steady_clock::now() - start;
+
+      tokens = count;
+      if (pass == 0 || elapsed.count() < best)
+         best = elapsed.count();
+      std::cout << "pass " << pass + 1 << ": " << elapsed.count() << " ms\n";
+   }
+
+   std::cout << "input: " << text.size() << " bytes, " << tokens << " tokens\n"
+             << "best: " << best << " ms, " << (text.size() / 1048576.0) / (best / 1000) << " MB/s, "
+             << best * 1e6 / tokens << " ns per token\n";
+
+   auto identifiers = split(text);
+   std::string identifierStr;
+   long hashSum = 0, comparisonSum = 0;
+   double hashTime = timeClassify([](const char* s, std::size_t length) {
+      return lexer::classifyIdentifier(s, length);
+   }, identifiers, passes, hashSum);
+   double comparisonTime = timeClassify([&identifierStr](const char* s, std::size_t length) {
+      return classifyByComparison(identifierStr, s, length);
+   }, identifiers, passes, comparisonSum);
+   if (hashSum != comparisonSum)
+   {
+      std::cerr << "Error: the keyword recognitions disagree\n";
+      return 1;
+   }
+
+   std::cout << "keyword recognition: perfect hash " << hashTime * 1e6 / identifiers.size() << " ns, "
+             << "string comparisons " << comparisonTime * 1e6 / identifiers.size() << " ns per identifier ("
+             << comparisonTime / hashTime << "x)\n";
+   return 0;
+}
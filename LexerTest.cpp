@@ -0,0 +1,101 @@
+//
+//  LexerTest.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 16/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+//  Lexer tests: every input is tokenized to its end and compared with the tokens expected,
+//  numbers with their value. Prints the cases that fail, exits with 1 if any does.
+//
+//  usage: lexertest.out
+//
+
+#include "InputSource.h"
+#include "Interner.h"
+#include "Lexer.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+   ///
+   /// @brief: a token expected, value is the one of a tok_number
+   ///
+   struct Expected
+   {
+      int token;
+      double value;
+   };
+
+   Expected number(double value) { return Expected{lexer::tok_number, value}; }
+   Expected token(int kind) { return Expected{kind, 0}; }
+
+   struct Case
+   {
+      const char* input;
+      std::vector<Expected> tokens;
+   };
+
+   const Case Cases[] = {
+      // the exponent of a decimal literal takes a sign
+      {"1e+3", {number(1000)}},
+      {"1.5e-1", {number(0.15)}},
+      {"2E+2-1", {number(200), token('-'), number(1)}},
+      // in a hex literal 'e' is a digit: the sign after it is an operator
+      {"0xe+1", {number(14), token('+'), number(1)}},
+      {"0XE-1", {number(14), token('-'), number(1)}},
+      {"0x1e+0x1", {number(30), token('+'), number(1)}},
+      // the exponent of a hex literal is binary, marked by p
+      {"0x1p+4", {number(16)}},
+      {"0x1.8p-1", {number(0.75)}},
+      // the whole pp-number is one token, reported if malformed
+      {"1.2.3", {token(lexer::tok_error)}},
+      {"4x", {token(lexer::tok_error)}},
+      // keywords against identifiers
+      {"def iffy(x) if x then 1 else 2", {token(lexer::tok_def), token(lexer::tok_identifier), token('('),
+                                          token(lexer::tok_identifier), token(')'), token(lexer::tok_if),
+                                          token(lexer::tok_identifier), token(lexer::tok_then), number(1),
+                                          token(lexer::tok_else), number(2)}},
+   };
+
+   bool run(const Case& test)
+   {
+      util::Interner interner;
+      lexer::Lexer lexer(interner, std::make_unique<lexer::StringInputSource>(test.input));
+
+      std::size_t i = 0;
+      for (int token = lexer.gettok(); token != lexer::tok_eof; token = lexer.gettok(), ++i)
+      {
+         if (i == test.tokens.size() || token != test.tokens[i].token ||
+             (token == lexer::tok_number && lexer.getNum() != test.tokens[i].value))
+         {
+            std::cerr << "Error: '" << test.input << "': unexpected token " << i << " (" << token << ")\n";
+            return false;
+         }
+      }
+
+      if (i != test.tokens.size())
+      {
+         std::cerr << "Error: '" << test.input << "': " << i << " tokens, " << test.tokens.size() << " expected\n";
+         return false;
+      }
+      return true;
+   }
+}
+
+int main()
+{
+   std::size_t failed = 0;
+   for (const auto& test : Cases)
+   {
+      if (!run(test))
+         ++failed;
+   }
+
+   std::cout << sizeof(Cases) / sizeof(Cases[0]) - failed << " passed, " << failed << " failed\n";
+   return failed == 0 ? 0 : 1;
+}
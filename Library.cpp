@@ -0,0 +1,12 @@
+//
+//  Library.cpp
+//  Kaleidoscope-LLVM-Bis
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2016 Nicola Cabiddu. All rights reserved.
+//
+//  runtime of the language: linked in the compiler, so the jit finds it in the process, and
+//  built as library.o for the objects emitted ahead of time
+//
+
+#include "Library.h"
@@ -0,0 +1,300 @@
+//
+//  NumberScanner.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#include "NumberScanner.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace lexer
+{
+   namespace
+   {
+      // powers of ten that are exact in a double
+      constexpr double exactPowersOfTen[] = {
+         1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+      };
+
+      constexpr long maxExactPowerOfTen = 22;
+
+      // integers up to 2^53 are exact in a double
+      constexpr std::uint64_t maxExactMantissa = std::uint64_t(1) << 53;
+
+      // no more than 19 decimal digits fit in 64 bits
+      constexpr int maxDecimalDigits = 19;
+
+      // exponents are saturated well beyond the range of a double
+      constexpr long maxExponent = 100000;
+
+      inline bool isDigit(char c)
+      {
+         return isdigit(static_cast<unsigned char>(c));
+      }
+
+      inline bool isHexDigit(char c)
+      {
+         return isxdigit(static_cast<unsigned char>(c));
+      }
+
+      inline unsigned hexValue(char c)
+      {
+         return isDigit(c) ? c - '0' : (c | 0x20) - 'a' + 10;
+      }
+
+      ///
+      /// @brief: parse [+-]? digits. p is left after the last digit
+      ///
+      bool parseExponent(const char*& p, const char* end, long& exponent)
+      {
+         bool negative = false;
+         if (p != end && (*p == '+' || *p == '-'))
+         {
+            negative = *p == '-';
+            ++p;
+         }
+
+         if (p == end || !isDigit(*p))
+            return false;
+
+         long e = 0;
+         for (; p != end && isDigit(*p); ++p)
+         {
+            if (e < maxExponent)
+               e = e * 10 + (*p - '0');
+         }
+
+         exponent = negative ? -e : e;
+         return true;
+      }
+
+      // a double halfway between two neighbours has at most 767 significant decimal digits: the
+      // digits past those only tell whether the literal is above the halfway point, one sticky
+      // nonzero digit carries that
+      constexpr std::size_t maxStrtodDigits = 768;
+
+      // literals copied as they are for strtod
+      constexpr std::size_t maxCopiedLength = 127;
+
+      ///
+      /// @brief: slow path, correctly rounded conversion by the C library on a terminated copy of the
+      ///         literal, at most maxCopiedLength bytes
+      ///
+      double convertWithStrtod(const char* begin, const char* end)
+      {
+         char buffer[maxCopiedLength + 1];
+         std::size_t length = end - begin;
+         std::memcpy(buffer, begin, length);
+         buffer[length] = '\0';
+         return std::strtod(buffer, nullptr);
+      }
+
+      ///
+      /// @brief: slow path for the decimal literals too long for convertWithStrtod. The literal goes to
+      ///         strtod rewritten as digits 'e' exponent: the significand without its leading zeros,
+      ///         cut after maxStrtodDigits digits plus a sticky digit, the point folded into the exponent
+      ///
+      double convertLongDecimal(const char* begin, const char* end, long exponent, int significantDigits)
+      {
+         char buffer[maxStrtodDigits + 32];
+         std::size_t length = 0;
+         bool sticky = false;
+
+         for (const char* p = begin; p != end && *p != 'e' && *p != 'E'; ++p)
+         {
+            if (*p == '.')
+               continue;
+            if (length == 0 && *p == '0')
+               continue;
+
+            if (length < maxStrtodDigits)
+               buffer[length++] = *p;
+            else
+               sticky |= *p != '0';
+         }
+
+         // exponent scales the significantDigits digits kept by parseDecimal
+         exponent -= static_cast<long>(length) - significantDigits;
+         if (sticky)
+         {
+            buffer[length++] = '1';
+            --exponent;
+         }
+
+         std::snprintf(buffer + length, sizeof(buffer) - length, "e%ld", exponent);
+         return std::strtod(buffer, nullptr);
+      }
+
+      bool parseDecimal(const char* begin, const char* end, double& value)
+      {
+         const char* p = begin;
+         std::uint64_t mantissa = 0;
+         int significantDigits = 0;
+         long exponent = 0;
+         bool truncated = false;
+         std::size_t digits = 0;
+
+         for (; p != end && isDigit(*p); ++p, ++digits)
+         {
+            // leading zeros are not significant
+            if (mantissa == 0 && *p == '0')
+               continue;
+
+            if (significantDigits < maxDecimalDigits)
+            {
+               mantissa = mantissa * 10 + (*p - '0');
+               ++significantDigits;
+            }
+            else
+            {
+               ++exponent;
+               truncated |= *p != '0';
+            }
+         }
+
+         if (p != end && *p == '.')
+         {
+            for (++p; p != end && isDigit(*p); ++p, ++digits)
+            {
+               if (mantissa == 0 && *p == '0')
+               {
+                  --exponent;
+                  continue;
+               }
+
+               if (significantDigits < maxDecimalDigits)
+               {
+                  mantissa = mantissa * 10 + (*p - '0');
+                  ++significantDigits;
+                  --exponent;
+               }
+               else
+               {
+                  truncated |= *p != '0';
+               }
+            }
+         }
+
+         if (digits == 0)
+            return false;
+
+         if (p != end && (*p == 'e' || *p == 'E'))
+         {
+            long e;
+            if (!parseExponent(++p, end, e))
+               return false;
+            exponent += e;
+         }
+
+         if (p != end)
+            return false;
+
+         if (mantissa == 0)
+         {
+            value = 0.0;
+            return true;
+         }
+
+         // Clinger's fast path: both operands are exact, so the single rounding of the
+         // multiplication/division gives the correctly rounded result
+         if (!truncated && mantissa <= maxExactMantissa &&
+             exponent >= -maxExactPowerOfTen && exponent <= maxExactPowerOfTen)
+         {
+            value = static_cast<double>(mantissa);
+            value = exponent < 0 ? value / exactPowersOfTen[-exponent] : value * exactPowersOfTen[exponent];
+            return true;
+         }
+
+         if (static_cast<std::size_t>(end - begin) <= maxCopiedLength)
+            value = convertWithStrtod(begin, end);
+         else
+            value = convertLongDecimal(begin, end, exponent, significantDigits);
+         return true;
+      }
+
+      bool parseHex(const char* begin, const char* end, double& value)
+      {
+         const char* p = begin + 2;
+         std::uint64_t mantissa = 0;
+         long exponent = 0;
+         bool truncated = false;
+         std::size_t digits = 0;
+
+         for (; p != end && isHexDigit(*p); ++p, ++digits)
+         {
+            if (mantissa >> 60)
+            {
+               exponent += 4;
+               truncated |= hexValue(*p) != 0;
+            }
+            else
+            {
+               mantissa = (mantissa << 4) | hexValue(*p);
+            }
+         }
+
+         if (p != end && *p == '.')
+         {
+            for (++p; p != end && isHexDigit(*p); ++p, ++digits)
+            {
+               if (mantissa >> 60)
+               {
+                  truncated |= hexValue(*p) != 0;
+               }
+               else
+               {
+                  mantissa = (mantissa << 4) | hexValue(*p);
+                  exponent -= 4;
+               }
+            }
+         }
+
+         if (digits == 0)
+            return false;
+
+         if (p != end && (*p == 'p' || *p == 'P'))
+         {
+            long e;
+            if (!parseExponent(++p, end, e))
+               return false;
+            exponent += e;
+         }
+
+         if (p != end)
+            return false;
+
+         // an exact mantissa is scaled by a power of two with a single rounding
+         if (!truncated && mantissa < maxExactMantissa)
+         {
+            value = std::ldexp(static_cast<double>(mantissa), static_cast<int>(exponent));
+            return true;
+         }
+
+         // the digits dropped only matter as a sticky bit, far below the 53 bits of a double:
+         // strtod rounds the mantissa kept once, a literal of any length fits in the buffer
+         char buffer[64];
+         std::snprintf(buffer, sizeof(buffer), "0x%llxp%ld",
+                       static_cast<unsigned long long>(mantissa | (truncated ? 1 : 0)), exponent);
+         value = std::strtod(buffer, nullptr);
+         return true;
+      }
+   }
+
+   bool parseNumber(const char* begin, const char* end, double& value)
+   {
+      if (end - begin > 2 && begin[0] == '0' && (begin[1] == 'x' || begin[1] == 'X'))
+         return parseHex(begin, end, value);
+
+      return parseDecimal(begin, end, value);
+   }
+
+}
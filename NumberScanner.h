@@ -0,0 +1,33 @@
+//
+//  NumberScanner.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef NumberScanner_h
+#define NumberScanner_h
+
+namespace lexer
+{
+
+   ///
+   /// @brief: convert the numeric literal [begin, end) to the nearest double.
+   ///         The whole span must match the literal grammar, otherwise false is returned:
+   ///
+   ///         number   ::= decimal | hex
+   ///         decimal  ::= digits ('.' digits?)? exponent? | '.' digits exponent?
+   ///         exponent ::= [eE] [+-]? digits
+   ///         hex      ::= '0' [xX] hexdigits ('.' hexdigits?)? binexp? | '0' [xX] '.' hexdigits binexp?
+   ///         binexp   ::= [pP] [+-]? digits
+   ///
+   ///         The common literals (up to 19 significant digits and small exponents) are converted
+   ///         exactly with integer arithmetic, the others by strtod on a stack buffer: nothing is
+   ///         allocated, whatever the length of the literal
+   ///
+   bool parseNumber(const char* begin, const char* end, double& value);
+
+}
+
+#endif /* NumberScanner_h */
@@ -0,0 +1,218 @@
+//
+//  ObjectCache.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#include "ObjectCache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <tuple>
+#include <vector>
+
+namespace jit
+{
+
+   namespace
+   {
+      const char* const ObjectExtension = ".o";
+
+      bool isObject(const std::string& path)
+      {
+         return llvm::sys::path::extension(path) == ObjectExtension;
+      }
+   }
+
+   ObjectCache::ObjectCache(std::string directory, std::uint64_t maxSize, std::string target) :
+      directory_(std::move(directory)),
+      maxSize_(maxSize),
+      target_(std::move(target)),
+      size_(0),
+      hits_(0),
+      misses_(0)
+   {
+      std::error_code error;
+      for (llvm::sys::fs::directory_iterator entry(directory_, error), end; entry != end && !error; entry.increment(error))
+      {
+         auto status = entry->status();
+         if (status && isObject(entry->path()))
+            size_ += status->getSize();
+      }
+   }
+
+   std::string ObjectCache::describeTarget(const std::string& triple, const std::string& cpu,
+                                           const std::string& features, int optLevel)
+   {
+      return triple + "/" + cpu + "/" + features + "/O" + std::to_string(optLevel);
+   }
+
+   std::string ObjectCache::describeTarget(const llvm::TargetMachine& targetMachine)
+   {
+      return describeTarget(targetMachine.getTargetTriple().str(), targetMachine.getTargetCPU().str(),
+                            targetMachine.getTargetFeatureString().str(), targetMachine.getOptLevel());
+   }
+
+   std::string ObjectCache::getKey(const llvm::Module& module) const
+   {
+      // the bitcode has every detail of the IR, value names included
+      llvm::SmallVector<char, 0> bitcode;
+      llvm::raw_svector_ostream out(bitcode);
+      llvm::WriteBitcodeToFile(module, out);
+
+      llvm::SHA1 hash;
+      hash.update(target_);
+      hash.update(llvm::StringRef(bitcode.data(), bitcode.size()));
+      return llvm::toHex(hash.final(), true);
+   }
+
+   std::string ObjectCache::getPath(const std::string& key) const
+   {
+      llvm::SmallString<128> path(directory_);
+      llvm::sys::path::append(path, key + ObjectExtension);
+      return path.str().str();
+   }
+
+   std::unique_ptr<llvm::MemoryBuffer> ObjectCache::getObject(const llvm::Module* module)
+   {
+      auto key = getKey(*module);
+      auto path = getPath(key);
+
+      auto object = llvm::MemoryBuffer::getFile(path, false, false);
+      if (!object)
+      {
+         // compiled next, notifyObjectCompiled stores the object under this key
+         std::lock_guard<std::mutex> lock(mutex_);
+         pending_[module] = std::move(key);
+         ++misses_;
+         return nullptr;
+      }
+
+      // recently used: the last to be evicted
+      int fd;
+      if (!llvm::sys::fs::openFileForWrite(path, fd, llvm::sys::fs::CD_OpenExisting, llvm::sys::fs::OF_Append))
+      {
+         llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+         llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+      }
+
+      ++hits_;
+      return std::move(*object);
+   }
+
+   void ObjectCache::notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object)
+   {
+      std::string key;
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         auto pending = pending_.find(module);
+         if (pending == pending_.end())
+            return;
+         key = std::move(pending->second);
+         pending_.erase(pending);
+      }
+
+      auto size = object.getBufferSize();
+      if (size > maxSize_)
+         return;
+
+      // written aside then renamed: a session reading the cache never sees half an object
+      llvm::SmallString<128> model(directory_);
+      llvm::sys::path::append(model, "%%%%%%%%.tmp");
+      auto file = llvm::sys::fs::TempFile::create(model);
+      if (!file)
+      {
+         std::cerr << "Error: cannot write the object cache: " << llvm::toString(file.takeError()) << "\n";
+         return;
+      }
+
+      {
+         llvm::raw_fd_ostream out(file->FD, false);
+         out << object.getBuffer();
+      }
+
+      if (auto error = file->keep(getPath(key)))
+      {
+         std::cerr << "Error: cannot write the object cache: " << llvm::toString(std::move(error)) << "\n";
+         llvm::consumeError(file->discard());
+         return;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      size_ += size;
+      if (size_ > maxSize_)
+         evict();
+   }
+
+   void ObjectCache::evict()
+   {
+      std::vector<std::tuple<llvm::sys::TimePoint<>, std::uint64_t, std::string>> objects;
+      std::uint64_t size = 0;
+
+      std::error_code error;
+      for (llvm::sys::fs::directory_iterator entry(directory_, error), end; entry != end && !error; entry.increment(error))
+      {
+         auto status = entry->status();
+         if (!status || !isObject(entry->path()))
+            continue;
+
+         objects.emplace_back(status->getLastModificationTime(), status->getSize(), entry->path());
+         size += status->getSize();
+      }
+
+      std::sort(objects.begin(), objects.end());
+
+      auto target = maxSize_ / 4 * 3;
+      for (const auto& object : objects)
+      {
+         if (size <= target)
+            break;
+
+         if (!llvm::sys::fs::remove(std::get<2>(object)))
+            size -= std::get<1>(object);
+      }
+
+      size_ = size;
+   }
+
+   std::unique_ptr<ObjectCache> createObjectCache(std::string directory, std::uint64_t maxSize, std::string target)
+   {
+      if (directory.empty())
+      {
+         llvm::SmallString<128> path;
+         if (!llvm::sys::path::cache_directory(path))
+         {
+            std::cerr << "Error: no cache directory for the object cache\n";
+            return nullptr;
+         }
+         llvm::sys::path::append(path, "kaleidoscope");
+         directory = path.str().str();
+      }
+
+      if (auto error = llvm::sys::fs::create_directories(directory))
+      {
+         std::cerr << "Error: cannot create " << directory << ": " << error.message() << "\n";
+         return nullptr;
+      }
+
+      return std::make_unique<ObjectCache>(std::move(directory), maxSize, std::move(target));
+   }
+
+}
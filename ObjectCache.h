@@ -0,0 +1,94 @@
+//
+//  ObjectCache.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef ObjectCache_h
+#define ObjectCache_h
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace llvm {
+   class TargetMachine;
+}
+
+namespace jit
+{
+
+   ///
+   /// @brief: objects compiled by the jit, kept on disk across sessions. An object is found by the
+   ///         hash of the IR it comes from (optimized already) and of the target: triple, cpu,
+   ///         features and optimization level of the code generator. A module seen before is not
+   ///         compiled again, its object is read back from the cache directory.
+   ///         The directory is bounded in size: once above it the objects used least recently
+   ///         are removed. Safe to use from the compile threads
+   ///
+   class ObjectCache : public llvm::ObjectCache
+   {
+   public:
+
+      ///
+      /// @brief: target is the description of the code generator, see describeTarget()
+      ///
+      ObjectCache(std::string directory, std::uint64_t maxSize, std::string target);
+
+      ObjectCache(const ObjectCache&) = delete;
+      ObjectCache& operator=(const ObjectCache&) = delete;
+
+      void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) override;
+      std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+      ///
+      /// @brief: what the objects of a code generator depend on besides the IR
+      ///
+      static std::string describeTarget(const std::string& triple, const std::string& cpu,
+                                        const std::string& features, int optLevel);
+      static std::string describeTarget(const llvm::TargetMachine& targetMachine);
+
+      ///
+      /// @brief: modules whose object came from the cache, and modules compiled
+      ///
+      std::size_t getHitCount() const { return hits_; }
+      std::size_t getMissCount() const { return misses_; }
+
+   private:
+
+      std::string getKey(const llvm::Module& module) const;
+      std::string getPath(const std::string& key) const;
+
+      ///
+      /// @brief: remove the objects used least recently until the directory is well below its bound,
+      ///         so that a full cache is not scanned at every store. Called with mutex_ held
+      ///
+      void evict();
+
+      std::string directory_;
+      std::uint64_t maxSize_;
+      std::string target_;
+
+      std::mutex mutex_;
+      std::uint64_t size_; //bytes in the directory, as far as this session knows
+      std::map<const llvm::Module*, std::string> pending_; //keys of the modules missed, until compiled
+      std::atomic<std::size_t> hits_;
+      std::atomic<std::size_t> misses_;
+   };
+
+   ///
+   /// @brief: cache in directory (created if missing, the user cache directory if empty),
+   ///         nullptr if it cannot be used
+   ///
+   std::unique_ptr<ObjectCache> createObjectCache(std::string directory, std::uint64_t maxSize, std::string target);
+
+}
+
+#endif /* ObjectCache_h */
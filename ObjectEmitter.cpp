@@ -0,0 +1,123 @@
+//
+//  ObjectEmitter.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#include "ObjectEmitter.h"
+
+#include <iostream>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+namespace code_generator
+{
+   namespace
+   {
+      llvm::CodeGenOpt::Level getCodeGenLevel(unsigned optLevel)
+      {
+         switch (optLevel)
+         {
+            case 0:
+               return llvm::CodeGenOpt::None;
+            case 1:
+               return llvm::CodeGenOpt::Less;
+            case 2:
+               return llvm::CodeGenOpt::Default;
+            default:
+               return llvm::CodeGenOpt::Aggressive;
+         }
+      }
+   }
+
+   ObjectEmitter::ObjectEmitter(const llvm::TargetMachine& host, unsigned optLevel)
+   {
+      const auto& triple = host.getTargetTriple().str();
+      
+      std::string error;
+      auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+      if (target == nullptr)
+      {
+         std::cerr << "Error: " << error << "\n";
+         return;
+      }
+      
+      targetMachine_.reset(target->createTargetMachine(triple,
+                                                       host.getTargetCPU(),
+                                                       host.getTargetFeatureString(),
+                                                       llvm::TargetOptions(),
+                                                       llvm::Reloc::PIC_,
+                                                       llvm::None,
+                                                       getCodeGenLevel(optLevel)));
+   }
+   
+   ObjectEmitter::~ObjectEmitter() = default;
+   
+   bool ObjectEmitter::emit(llvm::Module& module, const std::string& path, FileType type)
+   {
+      if (!targetMachine_)
+         return false;
+      
+      module.setTargetTriple(targetMachine_->getTargetTriple().str());
+      module.setDataLayout(targetMachine_->createDataLayout());
+      
+      std::error_code error;
+      llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_None);
+      if (error)
+      {
+         std::cerr << "Error: cannot write " << path << ": " << error.message() << "\n";
+         return false;
+      }
+      
+      auto fileType = type == ObjectFile ? llvm::CGFT_ObjectFile : llvm::CGFT_AssemblyFile;
+      
+      llvm::legacy::PassManager passes;
+      if (targetMachine_->addPassesToEmitFile(passes, out, nullptr, fileType))
+      {
+         std::cerr << "Error: the target cannot emit this kind of file\n";
+         return false;
+      }
+      
+      passes.run(module);
+      return true;
+   }
+   
+   llvm::Function* ObjectEmitter::createEntryPoint(llvm::Module& module)
+   {
+      if (module.getFunction("main"))
+         return nullptr;
+      
+      // the functions of a module are in the order they were generated, which is the source order
+      llvm::SmallVector<llvm::Function*, 16> expressions;
+      for (auto& function : module)
+      {
+         if (!function.isDeclaration() && function.getName().startswith("__anon_expr"))
+            expressions.push_back(&function);
+      }
+      
+      if (expressions.empty())
+         return nullptr;
+      
+      auto& context = module.getContext();
+      auto mainType = llvm::FunctionType::get(llvm::Type::getInt32Ty(context), false);
+      auto entry = llvm::Function::Create(mainType, llvm::Function::ExternalLinkage, "main", &module);
+      
+      llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", entry));
+      for (auto expression : expressions)
+         builder.CreateCall(expression);
+      
+      builder.CreateRet(builder.getInt32(0));
+      return entry;
+   }
+
+}
@@ -0,0 +1,69 @@
+//
+//  ObjectEmitter.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef ObjectEmitter_h
+#define ObjectEmitter_h
+
+#include <memory>
+#include <string>
+
+namespace llvm
+{
+   class Function;
+   class Module;
+   class TargetMachine;
+}
+
+namespace code_generator
+{
+
+   ///
+   /// @brief: ahead of time backend, lowers a module to a native object or assembly file.
+   ///         It targets the host the jit runs on, but with position independent code so that
+   ///         the objects link in executables and shared libraries. The objects need the runtime
+   ///         of Library.h (library.o) for putchard and printd
+   ///
+   class ObjectEmitter
+   {
+   public:
+
+      enum FileType
+      {
+         ObjectFile,
+         AssemblyFile
+      };
+
+      ///
+      /// @brief: emitter for the target of host, optLevel (0 to 3) is the level of the backend
+      ///
+      explicit ObjectEmitter(const llvm::TargetMachine& host, unsigned optLevel);
+      ~ObjectEmitter();
+
+      ObjectEmitter(const ObjectEmitter&) = delete;
+      ObjectEmitter& operator=(const ObjectEmitter&) = delete;
+
+      ///
+      /// @brief: write module to path, returns false (error reported) if it cannot
+      ///
+      bool emit(llvm::Module& module, const std::string& path, FileType type);
+
+      ///
+      /// @brief: add to module a main running its top level expressions in order, so that the
+      ///         object links into a standalone executable. Returns nullptr (nothing added) if the
+      ///         module has no top level expression or already has a main
+      ///
+      static llvm::Function* createEntryPoint(llvm::Module& module);
+
+   private:
+
+      std::unique_ptr<llvm::TargetMachine> targetMachine_;
+   };
+
+}
+
+#endif /* ObjectEmitter_h */
@@ -8,50 +8,301 @@
 
 #include "Optimizer.h"
 
+#include <iostream>
+
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
 #include "llvm/IR/Module.h"
-#include "llvm/IR/Verifier.h"
-#include "llvm/Support/TargetSelect.h"
-#include "llvm/Transforms/Scalar.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Target/TargetMachine.h"
 
 namespace optimizer
 {
+   namespace
+   {
+      ///
+      /// string attribute marking the functions already optimized
+      ///
+      const char* const OptimizedAttribute = "kaleidoscope.optimized";
+      
+      llvm::OptimizationLevel getPassBuilderLevel(OptLevel level)
+      {
+         switch (level)
+         {
+            case OptLevel::O0: return llvm::OptimizationLevel::O0;
+            case OptLevel::O1: return llvm::OptimizationLevel::O1;
+            case OptLevel::O2: return llvm::OptimizationLevel::O2;
+            case OptLevel::O3: return llvm::OptimizationLevel::O3;
+            case OptLevel::Os: return llvm::OptimizationLevel::Os;
+         }
+         
+         return llvm::OptimizationLevel::O2;
+      }
+   }
+   
+   ///
+   /// @brief: pass builder, analysis managers and pipelines of the session. The analysis
+   ///         managers are declared first so that they go after the pipelines, loop first
+   ///         since the proxies of the outer levels point to the inner managers
    ///
-   /// @brief: construct optimizer and init the function passage manager
+   struct Optimizer::PassState
+   {
+      explicit PassState(llvm::TargetMachine* targetMachine) : passBuilder(targetMachine)
+      {
+         passBuilder.registerModuleAnalyses(moduleAnalyses);
+         passBuilder.registerCGSCCAnalyses(cgsccAnalyses);
+         passBuilder.registerFunctionAnalyses(functionAnalyses);
+         passBuilder.registerLoopAnalyses(loopAnalyses);
+         passBuilder.crossRegisterProxies(loopAnalyses, functionAnalyses, cgsccAnalyses, moduleAnalyses);
+      }
+      
+      ///
+      /// @brief: forget the results of a run, the registered analyses stay
+      ///
+      void clearAnalyses()
+      {
+         loopAnalyses.clear();
+         functionAnalyses.clear();
+         cgsccAnalyses.clear();
+         moduleAnalyses.clear();
+      }
+      
+      llvm::PassBuilder passBuilder;
+      llvm::LoopAnalysisManager loopAnalyses;
+      llvm::FunctionAnalysisManager functionAnalyses;
+      llvm::CGSCCAnalysisManager cgsccAnalyses;
+      llvm::ModuleAnalysisManager moduleAnalyses;
+      
+      std::unique_ptr<llvm::FunctionPassManager> functionPipeline;
+      std::unique_ptr<llvm::ModulePassManager> modulePipeline;
+   };
+   
    ///
-   Optimizer::Optimizer() : funcPassManager_(nullptr)
+   /// @brief: construct optimizer, the passes are built on first use
+   ///
+   Optimizer::Optimizer(OptLevel level) :
+      state_(nullptr),
+      level_(level),
+      policy_(Policy::PerFunction),
+      functionPipeline_(false),
+      pipelineWarned_(false),
+      targetMachine_(nullptr),
+      optimizedCount_(0),
+      reoptimizedCount_(0)
    {}
    
+   Optimizer::~Optimizer() = default;
+   
+   void Optimizer::setLevel(OptLevel level)
+   {
+      if (level_ == level)
+         return;
+      
+      level_ = level;
+      resetPipelines();
+   }
+   
+   OptLevel Optimizer::getLevel() const
+   {
+      return level_;
+   }
+   
+   void Optimizer::setPolicy(Policy policy)
+   {
+      policy_ = policy;
+   }
+   
+   Policy Optimizer::getPolicy() const
+   {
+      return policy_;
+   }
+   
+   std::size_t Optimizer::getOptimizedCount() const
+   {
+      return optimizedCount_;
+   }
+   
+   std::size_t Optimizer::getReoptimizedCount() const
+   {
+      return reoptimizedCount_;
+   }
+   
+   bool Optimizer::isOptimized(const llvm::Function& function)
+   {
+      return function.hasFnAttribute(OptimizedAttribute);
+   }
+   
+   void Optimizer::stripMarks(llvm::Module& module)
+   {
+      for (auto& function : module)
+         function.removeFnAttr(OptimizedAttribute);
+   }
+   
+   void Optimizer::markOptimized(llvm::Function& function)
+   {
+      if (isOptimized(function))
+      {
+         ++reoptimizedCount_;
+         return;
+      }
+      
+      function.addFnAttr(OptimizedAttribute);
+      ++optimizedCount_;
+   }
+   
+   bool Optimizer::setPipeline(const std::string& pipeline)
+   {
+      bool functionPipeline = false;
+      if (!pipeline.empty())
+      {
+         auto& passBuilder = getPassState().passBuilder;
+         llvm::ModulePassManager passManager;
+         if (auto error = passBuilder.parsePassPipeline(passManager, pipeline))
+         {
+            std::cerr << "Error: invalid pass pipeline " << pipeline << ": " << llvm::toString(std::move(error)) << "\n";
+            return false;
+         }
+         
+         // the same text read as function passes, if it is made of them only
+         llvm::FunctionPassManager functionPasses;
+         auto error = passBuilder.parsePassPipeline(functionPasses, pipeline);
+         functionPipeline = !error;
+         llvm::consumeError(std::move(error));
+      }
+      
+      pipeline_ = pipeline;
+      functionPipeline_ = functionPipeline;
+      pipelineWarned_ = false;
+      resetPipelines();
+      return true;
+   }
+   
+   void Optimizer::setTargetMachine(llvm::TargetMachine& targetMachine)
+   {
+      if (targetMachine_ == &targetMachine)
+         return;
+      
+      // the pass builder registers the target analyses of its machine
+      targetMachine_ = &targetMachine;
+      state_.reset();
+   }
+   
+   void Optimizer::registerFunctionPass(FunctionPassRegistration registration)
+   {
+      registeredPasses_.push_back(std::move(registration));
+      resetPipelines();
+   }
+   
+   Optimizer::PassState& Optimizer::getPassState()
+   {
+      if (!state_)
+         state_ = std::make_unique<PassState>(targetMachine_);
+      
+      return *state_;
+   }
+   
+   void Optimizer::resetPipelines()
+   {
+      if (!state_)
+         return;
+      
+      state_->functionPipeline.reset();
+      state_->modulePipeline.reset();
+   }
+   
    ///
-   /// @brief: run FunctionPassManager optimizer for the function passed
+   /// @brief: function pipeline, the textual one if it is made of function passes, otherwise the
+   ///         simplification pipeline of the level, followed by our passes
    ///
-   void Optimizer::runLocalFunctionOptimization(llvm::Function *f)
+   llvm::FunctionPassManager& Optimizer::getFunctionPipeline()
    {
-      funcPassManager_->run(*f);
+      auto& state = getPassState();
+      if (state.functionPipeline)
+         return *state.functionPipeline;
+      
+      llvm::FunctionPassManager passManager;
+      if (functionPipeline_)
+         llvm::cantFail(state.passBuilder.parsePassPipeline(passManager, pipeline_)); //checked by setPipeline
+      else
+         passManager = state.passBuilder.buildFunctionSimplificationPipeline(getPassBuilderLevel(level_),
+                                                                             llvm::ThinOrFullLTOPhase::None);
+      for (const auto& registration : registeredPasses_)
+         registration(passManager);
+      
+      state.functionPipeline = std::make_unique<llvm::FunctionPassManager>(std::move(passManager));
+      return *state.functionPipeline;
    }
    
+   ///
+   /// @brief: module pipeline, the textual one if set, followed by our passes
+   ///
+   llvm::ModulePassManager& Optimizer::getModulePipeline()
+   {
+      auto& state = getPassState();
+      if (state.modulePipeline)
+         return *state.modulePipeline;
+      
+      llvm::ModulePassManager passManager;
+      if (!pipeline_.empty())
+         llvm::cantFail(state.passBuilder.parsePassPipeline(passManager, pipeline_)); //checked by setPipeline
+      else if (level_ != OptLevel::O0)
+         passManager = state.passBuilder.buildPerModuleDefaultPipeline(getPassBuilderLevel(level_));
+      
+      if (!registeredPasses_.empty())
+      {
+         llvm::FunctionPassManager functionPasses;
+         for (const auto& registration : registeredPasses_)
+            registration(functionPasses);
+         passManager.addPass(llvm::createModuleToFunctionPassAdaptor(std::move(functionPasses)));
+      }
+      
+      state.modulePipeline = std::make_unique<llvm::ModulePassManager>(std::move(passManager));
+      return *state.modulePipeline;
+   }
    
    ///
-   /// @brief: premature optimization for function generated (mainly peephole opt)
+   /// @brief: run the function pipeline on the function passed
    ///
+   void Optimizer::optimizeFunction(llvm::Function& function)
+   {
+      if (policy_ != Policy::PerFunction)
+         return;
+      
+      if (!pipeline_.empty() && !functionPipeline_ && !pipelineWarned_)
+      {
+         std::cerr << "Warning: the pass pipeline " << pipeline_ << " has module passes, "
+                   << "the functions optimized one by one get the pipeline of the level\n";
+         pipelineWarned_ = true;
+      }
+      
+      if (level_ == OptLevel::O0 && !functionPipeline_)
+         return;
+      
+      getFunctionPipeline().run(function, state_->functionAnalyses);
+      state_->clearAnalyses();
+      markOptimized(function);
+   }
+   
+   void Optimizer::runLocalFunctionOptimization(llvm::Function* f)
+   {
+      optimizeFunction(*f);
+   }
    
-   void Optimizer::enablePrematureOptimization(llvm::Module* module)
+   void Optimizer::optimizeModule(llvm::Module& module)
    {
-      //initializa the function passage manager
-      funcPassManager_ = std::make_unique<llvm::legacy::FunctionPassManager>(module);
+      if (policy_ != Policy::PerModule || (level_ == OptLevel::O0 && pipeline_.empty()))
+         return;
       
-      // Do simple "peephole" optimizations plus something else.
-      funcPassManager_->add(llvm::createInstructionCombiningPass());
-      // Reassociate expressions.
-      funcPassManager_->add(llvm::createReassociatePass());
-      // Eliminate Common SubExpressions.
-      funcPassManager_->add(llvm::createNewGVNPass());
-      // Simplify the control flow graph (deleting unreachable blocks, etc).
-      funcPassManager_->add(llvm::createCFGSimplificationPass());
-      //do init
-      funcPassManager_->doInitialization();
-
+      getModulePipeline().run(module, state_->moduleAnalyses);
+      state_->clearAnalyses();
+      
+      for (auto& function : module)
+      {
+         if (!function.isDeclaration())
+            markOptimized(function);
+      }
    }
 
    
 }
-
@@ -9,29 +9,153 @@
 #ifndef Optimizer_h
 #define Optimizer_h
 
+#include <cstddef>
+#include <functional>
 #include <memory>
-#include "llvm/IR/LegacyPassManager.h"
+#include <string>
+#include <vector>
+#include "llvm/IR/PassManager.h"
 
 namespace llvm {
    class Function;
    class Module;
+   class TargetMachine;
 }
 
 namespace  optimizer
 {
    ///
-   /// @brief: optimizer
+   /// @brief: optimization levels, the default pipelines of the PassBuilder.
+   ///         O0 nothing
+   ///         O1 .. O3 the pipelines of clang at the same level
+   ///         Os O2 tuned for size
+   ///
+   enum class OptLevel
+   {
+      O0,
+      O1,
+      O2,
+      O3,
+      Os
+   };
+   
+   ///
+   /// @brief: when the code is optimized.
+   ///         PerFunction every function as soon as it is generated, with the function pipeline (REPL)
+   ///         PerModule   a whole module once it is complete, with the module pipeline (batch mode)
+   ///
+   enum class Policy
+   {
+      PerFunction,
+      PerModule
+   };
+   
+   ///
+   /// @brief: adds passes of our own to a function pipeline
+   ///
+   using FunctionPassRegistration = std::function<void(llvm::FunctionPassManager&)>;
+   
+   ///
+   /// @brief: optimizer, the single owner of the optimization of the session: nothing else runs
+   ///         passes on the generated code. It sits on the new pass manager: under PerFunction
+   ///         functions are optimized one by one with the function simplification pipeline of
+   ///         the level, under PerModule modules holding many functions with the per module
+   ///         default pipeline, which also inlines and transforms loops.
+   ///         A textual pipeline in the syntax of opt -passes ("function(sroa,instcombine)")
+   ///         replaces the module pipeline of the level, and the function pipeline when it holds
+   ///         function passes only: one with module passes cannot run on a single function, the
+   ///         functions optimized one by one keep the pipeline of the level (with a warning, once).
+   ///         Passes of our own, registered with
+   ///         registerFunctionPass, run at the end of the function pipeline and of the module
+   ///         one, on every function.
+   ///         Optimized functions are marked ("kaleidoscope.optimized"), the counters tell how many
+   ///         functions went through the passes and how many of them more than once. The marks
+   ///         are stripped from the modules written to disk.
+   ///         The analysis managers and the pipelines are built on first use and reused by every
+   ///         module after: the pipelines are rebuilt when the level, the textual pipeline or the
+   ///         registered passes change, the analysis managers when the target changes.
+   ///         Cached analyses live as long as one run, the IR they describe goes to the jit after.
+   ///         The optimizer belongs to the code generator of the session, which runs on a single thread
    ///
    class Optimizer
    {
-      std::unique_ptr<llvm::legacy::FunctionPassManager> funcPassManager_;
+      struct PassState;
+      
+      std::unique_ptr<PassState> state_;
+      OptLevel level_;
+      Policy policy_;
+      std::string pipeline_;
+      bool functionPipeline_; //pipeline_ holds function passes only
+      bool pipelineWarned_; //the function pipeline of the level replaced pipeline_
+      std::vector<FunctionPassRegistration> registeredPasses_;
+      llvm::TargetMachine* targetMachine_;
+      
+      std::size_t optimizedCount_;
+      std::size_t reoptimizedCount_;
       
+      PassState& getPassState();
+      llvm::FunctionPassManager& getFunctionPipeline();
+      llvm::ModulePassManager& getModulePipeline();
+      void resetPipelines();
+      void markOptimized(llvm::Function& function);
       
    public:
-      explicit Optimizer();
-      void enablePrematureOptimization(llvm::Module* module);
+      explicit Optimizer(OptLevel level = OptLevel::O2);
+      ~Optimizer();
+      
+      void setLevel(OptLevel level);
+      OptLevel getLevel() const;
+      
+      void setPolicy(Policy policy);
+      Policy getPolicy() const;
+      
+      ///
+      /// @brief: set the textual pipeline, an empty one restores the pipeline of the level.
+      ///         Returns false (error reported, pipeline unchanged) if it does not parse as a
+      ///         module pipeline
+      ///
+      bool setPipeline(const std::string& pipeline);
+      
+      ///
+      /// @brief: target the passes query for their cost models (vectorizers, unrolling)
+      ///
+      void setTargetMachine(llvm::TargetMachine& targetMachine);
+      
+      ///
+      /// @brief: add passes of our own to the pipelines, in registration order
+      ///
+      void registerFunctionPass(FunctionPassRegistration registration);
+      
+      ///
+      /// @brief: optimize a function just generated, does nothing unless the policy is PerFunction
+      ///
+      void optimizeFunction(llvm::Function& function);
+      
+      ///
+      /// @brief: the entry point of the legacy pass manager optimizer, same as optimizeFunction
+      ///
       void runLocalFunctionOptimization(llvm::Function* f);
       
+      ///
+      /// @brief: run the module pipeline over a complete module, does nothing unless the policy
+      ///         is PerModule
+      ///
+      void optimizeModule(llvm::Module& module);
+      
+      std::size_t getOptimizedCount() const;
+      std::size_t getReoptimizedCount() const;
+      
+      ///
+      /// @brief: whether the function went through an optimizer already in this session
+      ///
+      static bool isOptimized(const llvm::Function& function);
+      
+      ///
+      /// @brief: remove the marks of the optimized functions from a module leaving the session
+      ///         (written to disk): they only mean something to the session that set them
+      ///
+      static void stripMarks(llvm::Module& module);
+      
    };
 }
 
@@ -12,21 +12,25 @@
 #include "Lexer.h"
 #include "AST.h"
 #include "Debug.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/raw_ostream.h"
 
 
 #include <cctype>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <iostream>
 
+#include <unistd.h>
+
 using namespace code_generator;
 using namespace lexer;
 
 namespace parser
 {
-   using ArgsExpr_t = std::vector<std::unique_ptr<ExprAST>>;
-   using ArgsStr_t = std::vector<std::string>;
+   //children are collected on the stack, then copied in the AST once complete
+   using ArgsStr_t = llvm::SmallVector<util::Symbol, 8>;
    
    
    debug::DebugInfo gDebugInfo;
@@ -37,11 +41,29 @@ namespace parser
    ///
    /// @brief: construct a pimpl lexer
    ///
-   Parser::Parser() :
+   Parser::Parser(std::unique_ptr<lexer::InputSource> source) :
+   codeGenerator_(jitCompiler_, interner_),
    curToken_(0),
-   codeGenerator_(jitCompiler_),
+   token_(),
    configurator_(util::CompilerConfigurator(codeGenerator_, jitCompiler_)),
-   lexer_(std::make_unique<Lexer>())
+   lexer_(std::make_unique<Lexer>(interner_, std::move(source))),
+   tokens_(*lexer_),
+   precedence_(codeGenerator_.getPrecedenceTable()),
+   treeBuilder_(context_),
+   flatBuilder_(flat_),
+   useFlatAST_(false),
+   jit_(true),
+   compileMode_(jit::CompileMode::Eager),
+   dumpAST_(false),
+   dumpLevel_(DumpNone),
+   bufferedErrs_(STDERR_FILENO, false),
+   dumpStream_(&bufferedErrs_),
+   batchMode_(false),
+   chunkSize_(0),
+   batchItems_(0),
+   errorCount_(0),
+   expressionCache_(interner_, jitCompiler_),
+   anonExprCount_(0)
    {
       codeGenerator_.InitializeModuleAndPassManager();
    }
@@ -52,19 +74,195 @@ namespace parser
    
    int Parser::getNextToken()
    {
-      curToken_ = lexer_->gettok();
+      token_ = tokens_.next();
+      curToken_ = token_.kind;
       return curToken_;
    }
    
-   int Parser::getTokenPrecedence()
+   void Parser::setInput(std::unique_ptr<lexer::InputSource> source)
+   {
+      lexer_->reset(std::move(source));
+      tokens_.reset();
+      curToken_ = 0;
+   }
+   
+   void Parser::tokenizeInput()
+   {
+      tokens_.tokenizeAll();
+   }
+   
+   const lexer::TokenRecord& Parser::peekToken(std::size_t n)
+   {
+      return tokens_.peek(n);
+   }
+   
+   std::size_t Parser::getTokenPosition() const
+   {
+      return tokens_.position() - 1;
+   }
+   
+   void Parser::seekToken(std::size_t position)
    {
-      if(!isascii(curToken_))
-         return -1;
+      tokens_.seek(position);
+      getNextToken();
+   }
+   
+   double Parser::getTokenNumber() const
+   {
+      return token_.number;
+   }
+   
+   util::Symbol Parser::getTokenSymbol() const
+   {
+      if (curToken_ != lexer::tok_identifier)
+         return util::Symbol();
       
-      //here we could throw.. what should I do? .. dunno now
+      return interner_.lookup(token_.symbol);
+   }
+   
+   const std::string& Parser::getTokenError() const
+   {
+      return tokens_.getError(token_);
+   }
+   
+   void Parser::setFlatAST(bool enable)
+   {
+      useFlatAST_ = enable;
+   }
+   
+   void Parser::setBatchMode(bool enable, std::size_t chunkSize)
+   {
+      if (!enable)
+         flushBatch();
+      
+      batchMode_ = enable;
+      chunkSize_ = chunkSize;
+      
+      // a module of the batch is refused if it defines a name again, the REPL replaces the definition
+      jitCompiler_.setRedefinition(!enable);
+      
+      // a batch module is optimized once it is complete, the REPL optimizes every function
+      if (compileMode_ != jit::CompileMode::Lazy)
+         codeGenerator_.getOptimizer().setPolicy(enable ? optimizer::Policy::PerModule : optimizer::Policy::PerFunction);
+   }
+   
+   void Parser::setJit(bool enable)
+   {
+      jit_ = enable;
+   }
+   
+   void Parser::setExpressionCache(std::size_t capacity)
+   {
+      expressionCache_.setCapacity(capacity);
+   }
+   
+   ExpressionCache& Parser::getExpressionCache()
+   {
+      return expressionCache_;
+   }
+   
+   void Parser::setCompileThreads(unsigned compileThreads)
+   {
+      jitCompiler_.setCompileThreads(compileThreads);
+   }
+   
+   void Parser::setCompileMode(jit::CompileMode mode)
+   {
+      compileMode_ = mode;
+      jitCompiler_.setCompileMode(mode);
+      
+      // tier 0 is compiled as it comes, tier 1 is optimized by the jit
+      auto& optimizer = codeGenerator_.getOptimizer();
+      if (mode == jit::CompileMode::Tiered)
+         optimizer.setLevel(optimizer::OptLevel::O0);
+      
+      if (mode != jit::CompileMode::Lazy)
+      {
+         optimizer.setPolicy(batchMode_ ? optimizer::Policy::PerModule : optimizer::Policy::PerFunction);
+         jitCompiler_.setModuleTransform(nullptr);
+         return;
+      }
+      
+      // the functions reach the optimizer one by one, when the jit compiles them. So do the
+      // functions of a precompiled module (--load): the file does not tell how it was optimized
+      optimizer.setPolicy(optimizer::Policy::PerModule);
+      jitCompiler_.setModuleTransform([this](llvm::Module& module) {
+         std::lock_guard<std::mutex> lock(optimizerMutex_);
+         codeGenerator_.getOptimizer().optimizeModule(module);
+      });
+   }
+   
+   optimizer::Optimizer& Parser::getOptimizer()
+   {
+      if (compileMode_ == jit::CompileMode::Tiered)
+         return jitCompiler_.getTierUpOptimizer();
+      
+      return codeGenerator_.getOptimizer();
+   }
+   
+   void Parser::setOptimizationLevel(optimizer::OptLevel level)
+   {
+      getOptimizer().setLevel(level);
+   }
+   
+   void Parser::setDumpLevel(DumpLevel level)
+   {
+      dumpLevel_ = level;
+   }
+   
+   void Parser::setDumpStream(llvm::raw_ostream& out)
+   {
+      dumpStream_->flush();
+      dumpStream_ = &out;
+   }
+   
+   bool Parser::setPassPipeline(const std::string& pipeline)
+   {
+      return getOptimizer().setPipeline(pipeline);
+   }
+   
+   void Parser::setDumpAST(bool enable)
+   {
+      dumpAST_ = enable;
+   }
+   
+   void Parser::setModuleSink(std::function<void(llvm::Module&)> sink)
+   {
+      moduleSink_ = std::move(sink);
+   }
+   
+   jit::JIT& Parser::getJitCompiler()
+   {
+      return jitCompiler_;
+   }
+   
+   code_generator::CodeGenerator& Parser::getCodeGenerator()
+   {
+      return codeGenerator_;
+   }
+   
+   bool Parser::loadModule(const std::string& path)
+   {
+      auto module = codeGenerator_.loadModule(path);
+      if (!module)
+         return false;
       
-      int tokenPrec = configurator_.getCodeGenerator().getOperatorPrecedence(curToken_);
-      return tokenPrec;
+      std::vector<std::pair<util::Symbol, std::vector<util::Symbol>>> definitions;
+      module.withModuleDo([&](llvm::Module& loaded) {
+         for (const auto& function : loaded)
+         {
+            if (!function.isDeclaration())
+               definitions.emplace_back(interner_.intern(function.getName()), expressionCache_.getCallees(function));
+         }
+      });
+      
+      if (jit_ && !jitCompiler_.addModule(std::move(module)))
+         return false;
+      
+      for (const auto& definition : definitions)
+         expressionCache_.define(definition.first, definition.second);
+      
+      return true;
    }
    
    void Parser::setTokenPrecedence(unsigned char token, int value)
@@ -73,135 +271,148 @@ namespace parser
       configurator_.getCodeGenerator().setOperatorPrecedence(token, value);
    }
    
-   expression_t Parser::error(const char* str)
+   void Parser::error(const char* str)
    {
       std::cerr << "Error: "<< str << "\n";
-      return nullptr;
-   }
-
-   prototype_t Parser::errorP(const char *str)
-   {
-      error(str);
-      return nullptr;
+      ++errorCount_;
    }
    
-   expression_t Parser::parseExpression()
+   template <typename Builder>
+   typename Builder::node_t Parser::parseExpression(Builder& builder)
    {
       //parseUnary();
-      auto lhs = parseUnary(); //parsePrimaryExpression();
-      if (!lhs)
-         return nullptr;
+      auto lhs = parseUnary(builder); //parsePrimaryExpression();
+      if (builder.isNull(lhs))
+         return builder.null();
       
-      return parseBinOpRHS(0, std::move(lhs));
+      return parseBinOpRHS(builder, 0, lhs);
    }
    
-   expression_t Parser::parseNumberExpr()
+   template <typename Builder>
+   typename Builder::node_t Parser::parseNumberExpr(Builder& builder)
    {
-      auto res = std::make_unique<AST::NumberExprAST>(configurator_.getCodeGenerator(), lexer_->getNum());
+      auto res = builder.number(getTokenNumber());
       getNextToken();
-      return std::move(res);
+      return res;
    }
    
-   expression_t Parser::parseParentExpr()
+   template <typename Builder>
+   typename Builder::node_t Parser::parseParentExpr(Builder& builder)
    {
       getNextToken();
       
-      auto v = parseExpression();
+      auto v = parseExpression(builder);
       
-      if(v == nullptr)
-         return nullptr;
+      if(builder.isNull(v))
+         return builder.null();
       
       if(curToken_ != ')')
-         return error("expected )");
+      {
+         error("expected )");
+         return builder.null();
+      }
    
       getNextToken();
       
       return v;
    }
    
-   expression_t Parser::parseIdentifierExpr()
+   template <typename Builder>
+   typename Builder::node_t Parser::parseIdentifierExpr(Builder& builder)
    {
-      auto idName = lexer_->getId();
+      auto idName = getTokenSymbol();
       
       //SourceLocation Idlocation = debugInfo_.currentLocation_;
       
       getNextToken();
       
       if( curToken_ != '(')
-         return std::make_unique<AST::VariableExprAST>(configurator_.getCodeGenerator(), idName);
+         return builder.variable(idName);
       
       getNextToken();
-      ArgsExpr_t args;
+      llvm::SmallVector<typename Builder::node_t, 8> args;
       
       if( curToken_ != ')')
       {
          while(1)
          {
-            auto arg = parseExpression();
-            if( arg != nullptr)
+            auto arg = parseExpression(builder);
+            if(!builder.isNull(arg))
             {
-               args.push_back(std::move(arg));
+               args.push_back(arg);
             }
             else
             {
-               return nullptr;
+               return builder.null();
             }
             
             if( curToken_ == ')')
                break;
             
             if(curToken_ != ',')
-               return error("Expected ) or , in argument list");
+            {
+               error("Expected ) or , in argument list");
+               return builder.null();
+            }
             
             getNextToken();
          }
       }
       
       getNextToken();
-      return std::make_unique<AST::CallExprAST>(configurator_.getCodeGenerator(), idName, std::move(args));
+      return builder.call(idName, args);
    }
    
-   expression_t Parser::parsePrimaryExpression()
+   template <typename Builder>
+   typename Builder::node_t Parser::parsePrimaryExpression(Builder& builder)
    {
       switch(curToken_)
       {
          default:
-            return error("Unknown token where aspecting an expression");
+            error("Unknown token where aspecting an expression");
+            return builder.null();
             
          case lexer::tok_identifier :
-            return parseIdentifierExpr();
+            return parseIdentifierExpr(builder);
             
          case lexer::tok_number:
-            return parseNumberExpr();
+            return parseNumberExpr(builder);
+            
+         case lexer::tok_error:
+            error(getTokenError().c_str());
+            return builder.null();
             
          case '(':
-            return parseParentExpr();
+            return parseParentExpr(builder);
          
          case lexer::tok_if:
-            return parseIfExpr();
+            return parseIfExpr(builder);
             
          case lexer::tok_for:
-            return parseForExpr();
+            return parseForExpr(builder);
             
          case lexer::tok_var:
-            return parseVarExpr();
+            return parseVarExpr(builder);
       }
    }
    
-   expression_t Parser::parseUnary()
+   template <typename Builder>
+   typename Builder::node_t Parser::parseUnary(Builder& builder)
    {
       if ( !isascii(curToken_) || curToken_ == '(' || curToken_ == ',')
-         return parsePrimaryExpression();
+         return parsePrimaryExpression(builder);
       
       int opcode = curToken_;
       getNextToken();
-      if (auto operand = parseUnary())
-         return std::make_unique<UnaryExprAST>(configurator_.getCodeGenerator(), opcode, std::move(operand));
+      auto operand = parseUnary(builder);
+      if (!builder.isNull(operand))
+         return builder.unary(opcode, operand);
       
-      return nullptr;
+      return builder.null();
    }
    
-   expression_t Parser::parseBinOpRHS(int exprPrec, expression_t lhs)
+   template <typename Builder>
+   typename Builder::node_t Parser::parseBinOpRHS(Builder& builder, int exprPrec, typename Builder::node_t lhs)
    {
       while( true )
       {
@@ -213,30 +424,31 @@ namespace parser
          //SourceLocation binaryOpLocation = debugInfo_.currentLocation_;
          getNextToken();
          
-         auto rhs = parseUnary(); 
-         if( rhs == nullptr)
-            return nullptr;
+         auto rhs = parseUnary(builder);
+         if(builder.isNull(rhs))
+            return builder.null();
          
-         int nextPrec = curToken_;
+         int nextPrec = getTokenPrecedence();
          if(tokenPrec < nextPrec)
          {
-            rhs = parseBinOpRHS(tokenPrec+1, std::move(rhs));
-            if(rhs == nullptr)
-               return nullptr;
+            rhs = parseBinOpRHS(builder, tokenPrec+1, rhs);
+            if(builder.isNull(rhs))
+               return builder.null();
          }
          
-         lhs = std::make_unique<AST::BinaryExprAST>(configurator_.getCodeGenerator(), binOp, std::move(lhs), std::move(rhs));
+         lhs = builder.binary(binOp, lhs, rhs);
       }
    }
    
-   prototype_t Parser::parsePrototype()
+   template <typename Builder>
+   typename Builder::prototype_t Parser::parsePrototype(Builder& builder)
    {
       //SourceLocation fnLocation = debugInfo_.currentLocation_;
 
       unsigned binaryPrecedence = 30;
       // by default I assume I am going to parse a prototype definition
       unsigned kind = 0; //0 (prototype) - 1(unary) - 2(binary)
-      std::string functionName = lexer_->getId();
+      auto functionName = getTokenSymbol();
       
       switch (curToken_)
       {
@@ -250,9 +462,12 @@ namespace parser
             getNextToken();
             
             if (!isascii(curToken_))
-               return errorP("Expected unary operator");
+            {
+               error("Expected unary operator");
+               return builder.null();
+            }
             
-            functionName = ("unary") + (char)curToken_;
+            functionName = interner_.intern(std::string("unary") + (char)curToken_);
             kind = 1;
             getNextToken();
             
@@ -262,203 +477,237 @@ namespace parser
             
             getNextToken();
             if (!isascii(curToken_))
-               return errorP("Expected binary operator");
+            {
+               error("Expected binary operator");
+               return builder.null();
+            }
             
-            functionName = ("binary") + (char)curToken_;
+            functionName = interner_.intern(std::string("binary") + (char)curToken_);
             kind = 2;
             getNextToken();
             
             
             if (curToken_ == lexer::tok_number)
             {
-               if (lexer_->getNum() < 1 || lexer_->getNum() > 100)
-                  return errorP("Invalid precedecnce: must be 1..100");
+               if (getTokenNumber() < 1 || getTokenNumber() > 100)
+               {
+                  error("Invalid precedecnce: must be 1..100");
+                  return builder.null();
+               }
                
-               binaryPrecedence = (unsigned)lexer_->getNum();
+               binaryPrecedence = (unsigned)getTokenNumber();
                getNextToken();
             }
             
             break;
             
          default:
-            return errorP("expected function name in prototype");
+            error("expected function name in prototype");
+            return builder.null();
       }
       
       if (curToken_ != '(')
-         return errorP("Expected '(' in prototype");
+      {
+         error("Expected '(' in prototype");
+         return builder.null();
+      }
       
       ArgsStr_t args;
       while(getNextToken() == lexer::tok_identifier)
-         args.push_back(lexer_->getId());
+         args.push_back(getTokenSymbol());
       
       if(curToken_!= ')')
-         return errorP("expected ')' in prototype");
+      {
+         error("expected ')' in prototype");
+         return builder.null();
+      }
       
       // success.
       getNextToken();
       
       if (kind && args.size() != kind)
-         return errorP("Invalid number of operands for operator");
+      {
+         error("Invalid number of operands for operator");
+         return builder.null();
+      }
       
-      return std::make_unique<AST::PrototypeAST>(configurator_.getCodeGenerator(),
-                                                 functionName,
-                                                 std::move(args),
-                                                 kind != 0,
-                                                 binaryPrecedence);
+      return builder.prototype(functionName, args, kind != 0, binaryPrecedence);
    }
    
-   function_t Parser::parseDefinition()
+   template <typename Builder>
+   typename Builder::function_t Parser::parseDefinition(Builder& builder)
    {
       getNextToken();
-      auto prototype = parsePrototype();
-      if(prototype == nullptr)
-         return nullptr;
+      auto prototype = parsePrototype(builder);
+      if(builder.isNull(prototype))
+         return builder.null();
       
-      auto expression = parseExpression();
-      if( expression != nullptr )
-      {
-         return
-         std::make_unique<AST::FunctionAST>(configurator_.getCodeGenerator(), std::move(prototype), std::move(expression));
-      }
+      auto expression = parseExpression(builder);
+      if(!builder.isNull(expression))
+         return builder.function(prototype, expression);
       
-      return nullptr;
+      return builder.null();
    }
    
-   function_t Parser::parseTopLevelExpr()
+   template <typename Builder>
+   typename Builder::function_t Parser::parseTopLevelExpr(Builder& builder)
    {
       //SourceLocation fnLocation = debugInfo_.currentLocation_;
-      auto expression = parseExpression();
-      if( expression != nullptr)
+      auto expression = parseExpression(builder);
+      if(!builder.isNull(expression))
       {
-         auto prototype = std::make_unique<AST::PrototypeAST>(configurator_.getCodeGenerator(),
-                                                              "__anon_expr", std::vector<std::string> {});
+         // in batch mode many expressions share a module, in the REPL the cached ones stay in the jit:
+         // each one needs its own name
+         bool unique = batchMode_ || (jit_ && expressionCache_.isEnabled());
+         auto name = unique ? "__anon_expr" + std::to_string(anonExprCount_++) : std::string("__anon_expr");
+         auto prototype = builder.prototype(interner_.intern(name), {});
          
-         return std::make_unique<AST::FunctionAST>(configurator_.getCodeGenerator(),
-                                                   std::move(prototype), std::move(expression));
+         return builder.function(prototype, expression);
       }
-      return nullptr;
+      return builder.null();
    }
    
-   prototype_t Parser::parseExtern()
+   template <typename Builder>
+   typename Builder::prototype_t Parser::parseExtern(Builder& builder)
    {
       getNextToken();
-      return parsePrototype();
+      return parsePrototype(builder);
    }
    
-   expression_t Parser::parseIfExpr()
+   template <typename Builder>
+   typename Builder::node_t Parser::parseIfExpr(Builder& builder)
    {
       //SourceLocation ifLocation = debugInfo_.currentLocation_;;
 
       getNextToken();
-      auto Cond = parseExpression();
+      auto Cond = parseExpression(builder);
       
-      if(!Cond)
-         return nullptr;
+      if(builder.isNull(Cond))
+         return builder.null();
       
       if (curToken_ != tok_then)
-         return errorP("expected then");
+      {
+         error("expected then");
+         return builder.null();
+      }
       
       getNextToken();
       
-      auto Then = parseExpression();
-      if (!Then)
-         return nullptr;
+      auto Then = parseExpression(builder);
+      if (builder.isNull(Then))
+         return builder.null();
       
       if (curToken_ != tok_else)
-         return errorP("expected else");
+      {
+         error("expected else");
+         return builder.null();
+      }
       
       getNextToken();
       
-      auto Else = parseExpression();
-      if (!Else)
-         return nullptr;
+      auto Else = parseExpression(builder);
+      if (builder.isNull(Else))
+         return builder.null();
       
-      return std::make_unique<IfExprAST>(configurator_.getCodeGenerator(),
-                                         std::move(Cond), std::move(Then), std::move(Else));
+      return builder.ifExpr(Cond, Then, Else);
    }
    
-   expression_t Parser::parseForExpr()
+   template <typename Builder>
+   typename Builder::node_t Parser::parseForExpr(Builder& builder)
    {
       getNextToken();
       
       if (curToken_ != tok_identifier)
-         return errorP("expected identifier after for");
+      {
+         error("expected identifier after for");
+         return builder.null();
+      }
       
-      std::string IdName = lexer_->getId();
+      auto IdName = getTokenSymbol();
       
       getNextToken();
       
       if (curToken_ != '=')
-         return errorP("expected '=' after for");
+      {
+         error("expected '=' after for");
+         return builder.null();
+      }
       
       getNextToken();
       
-      auto Start = parseExpression();
-      if (!Start)
-         return nullptr;
+      auto Start = parseExpression(builder);
+      if (builder.isNull(Start))
+         return builder.null();
       
       if (curToken_ != ',')
-         return errorP("expected ',' after for start value");
+      {
+         error("expected ',' after for start value");
+         return builder.null();
+      }
       
       getNextToken();
       
-      auto End = parseExpression();
-      if (!End)
-         return nullptr;
+      auto End = parseExpression(builder);
+      if (builder.isNull(End))
+         return builder.null();
       
       // The step value is optional.
-      expression_t Step;
+      typename Builder::node_t Step = builder.null();
       if (curToken_ == ',')
       {
          getNextToken();
-         Step = parseExpression();
-         if (!Step)
-            return nullptr;
+         Step = parseExpression(builder);
+         if (builder.isNull(Step))
+            return builder.null();
       }
       
       if (curToken_ != tok_in)
-         return errorP("expected 'in' after for");
+      {
+         error("expected 'in' after for");
+         return builder.null();
+      }
       
       getNextToken();
       
-      auto Body = parseExpression();
-      if (!Body)
-         return nullptr;
+      auto Body = parseExpression(builder);
+      if (builder.isNull(Body))
+         return builder.null();
       
-      return llvm::make_unique<ForExprAST>(configurator_.getCodeGenerator(),
-                                           IdName, std::move(Start),
-                                           std::move(End), std::move(Step),
-                                           std::move(Body));
+      return builder.forExpr(IdName, Start, End, Step, Body);
       
    }
    
-   expression_t Parser::parseVarExpr()
+   template <typename Builder>
+   typename Builder::node_t Parser::parseVarExpr(Builder& builder)
    {
       getNextToken(); // eat the var.
       
-      std::vector<std::pair<std::string, expression_t>> variableNames;
+      llvm::SmallVector<typename Builder::binding_t, 4> variableNames;
       
       // At least one variable name is required.
       if (curToken_ != tok_identifier)
-         return errorP("expected identifier after var");
+      {
+         error("expected identifier after var");
+         return builder.null();
+      }
       
       while (1)
       {
-         std::string name = lexer_->getId();
+         auto name = getTokenSymbol();
          getNextToken();
          
          // Read the optional initializer.
-         expression_t init = nullptr;
+         typename Builder::node_t init = builder.null();
          if (curToken_ == '=')
          {
             getNextToken(); // eat the '='.
             
-            init = parseExpression();
-            if (!init)
-               return nullptr;
+            init = parseExpression(builder);
+            if (builder.isNull(init))
+               return builder.null();
          }
          
-         variableNames.push_back(std::make_pair(name, std::move(init)));
+         variableNames.push_back(std::make_pair(name, init));
          
          // End of var list, exit loop.
          if (curToken_ != ',')
@@ -467,47 +716,144 @@ namespace parser
          getNextToken();
          
          if (curToken_ != tok_identifier)
-            return errorP("expected identifier list after var");
+         {
+            error("expected identifier list after var");
+            return builder.null();
+         }
       }
       
       // At this point, we have to have 'in'.
       if (curToken_ != tok_in)
-         return errorP("expected 'in' keyword after 'var'");
+      {
+         error("expected 'in' keyword after 'var'");
+         return builder.null();
+      }
       
       //eat in
       getNextToken();
       
-      auto body = parseExpression();
-      if (!body)
-         return nullptr;
+      auto body = parseExpression(builder);
+      if (builder.isNull(body))
+         return builder.null();
       
-      return std::make_unique<VarExprAST>(configurator_.getCodeGenerator(),
-                                          std::move(variableNames), std::move(body));
+      return builder.var(variableNames, body);
 
    }
+   
+   // the bench programs parse with builders of their own
+   template TreeBuilder::function_t Parser::parseDefinition(TreeBuilder&);
+   template FlatBuilder::function_t Parser::parseDefinition(FlatBuilder&);
+   template TreeBuilder::function_t Parser::parseTopLevelExpr(TreeBuilder&);
+   template FlatBuilder::function_t Parser::parseTopLevelExpr(FlatBuilder&);
+   template TreeBuilder::prototype_t Parser::parseExtern(TreeBuilder&);
+   template FlatBuilder::prototype_t Parser::parseExtern(FlatBuilder&);
 
    
+   Function* Parser::codeGenFunction(const FunctionAST* function)
+   {
+      return codeGenerator_.codeGenFunctionExpr(function);
+   }
+   
+   Function* Parser::codeGenFunction(NodeId function)
+   {
+      return codeGenerator_.codeGenFunctionExpr(flat_, function);
+   }
+   
+   Function* Parser::codeGenPrototype(const PrototypeAST* prototype)
+   {
+      return codeGenerator_.codeGenPrototypeExpr(prototype);
+   }
+   
+   Function* Parser::codeGenPrototype(NodeId prototype)
+   {
+      return codeGenerator_.codeGenPrototypeExpr(flat_, prototype);
+   }
+   
+   void Parser::cachePrototype(const PrototypeAST* prototype)
+   {
+      configurator_.getCodeGenerator().addProtypeCache(prototype->getName(), prototype);
+   }
+   
+   void Parser::cachePrototype(NodeId prototype)
+   {
+      configurator_.getCodeGenerator().addProtypeCache(flat_, prototype);
+   }
+   
+   util::Symbol Parser::getFunctionName(const FunctionAST* function) const
+   {
+      return function->getPrototype()->getName();
+   }
+   
+   util::Symbol Parser::getFunctionName(NodeId function) const
+   {
+      return flat_.prototypeName(flat_.functionPrototype(function));
+   }
+   
+   ExpressionCache::entry_point_t Parser::lookupExpression(const FunctionAST* function)
+   {
+      return expressionCache_.lookup(function->getBody());
+   }
+   
+   ExpressionCache::entry_point_t Parser::lookupExpression(NodeId function)
+   {
+      // the body is parsed first, nodes [0, body] in flat_
+      return expressionCache_.lookup(flat_, flat_.functionBody(function));
+   }
+   
+   void Parser::dumpAST(const ExprAST* node)
+   {
+      node->dump(*dumpStream_, 0);
+   }
+   
+   void Parser::dumpAST(NodeId node)
+   {
+      flat_.dump(*dumpStream_, node, 0);
+   }
+   
    ///
    /// Top-Level parsing
    ///
    
-   void Parser::handleDefinition()
+   template <typename Builder>
+   void Parser::handleDefinition(Builder& builder)
    {
-      if(const auto& parsedDefinition = parseDefinition())
+      auto parsedDefinition = parseDefinition(builder);
+      if(!builder.isNull(parsedDefinition))
       {
-         if( const auto* defintionIR = parsedDefinition->codeGen())
+         if (dumpAST_)
+            dumpAST(parsedDefinition);
+         
+         if( const auto* defintionIR = codeGenFunction(parsedDefinition))
          {
-            defintionIR->print(llvm::errs());
+            dump(defintionIR);
+            
+            if (batchMode_)
+            {
+               addToBatch();
+               return;
+            }
+            
+            // the cached expressions go stale once the jit has the new definition, not before
+            auto callees = expressionCache_.getCallees(*defintionIR);
             
             //TODO: remove this hack!!
-            std::unique_ptr<llvm::Module> module;
+            llvm::orc::ThreadSafeModule module;
             codeGenerator_.getModule(module);
             
-            jitCompiler_.addModule(module);
+            // compiled in background, the parser goes on with the next item. A definition
+            // replaces the one of the same name (see setBatchMode)
+            if (jit_ && !jitCompiler_.addModule(std::move(module)))
+               ++errorCount_; //reported by the jit
+            else
+               expressionCache_.define(getFunctionName(parsedDefinition), callees);
             codeGenerator_.InitializeModuleAndPassManager();
 
             //jit_->addModule(std::move)
          }
+         else
+         {
+            ++errorCount_; //reported by the code generator
+         }
       }
       else
       {
@@ -515,14 +861,23 @@ namespace parser
       }
    }
    
-   void Parser::handleExtern()
+   template <typename Builder>
+   void Parser::handleExtern(Builder& builder)
    {
-      if(auto parsedExtern = parseExtern())
+      auto parsedExtern = parseExtern(builder);
+      if(!builder.isNull(parsedExtern))
       {
-         if(const auto* externIR = parsedExtern->codeGen())
+         if (dumpAST_)
+            dumpAST(parsedExtern);
+         
+         if(const auto* externIR = codeGenPrototype(parsedExtern))
+         {
+            dump(externIR);
+            cachePrototype(parsedExtern);
+         }
+         else
          {
-            externIR->print(llvm::errs());
-            configurator_.getCodeGenerator().addProtypeCache(parsedExtern->getName(), parsedExtern);
+            ++errorCount_;
          }
       }
       else
@@ -531,34 +886,72 @@ namespace parser
       }
    }
    
-   void Parser::handleTopLevelExpression()
+   template <typename Builder>
+   void Parser::handleTopLevelExpression(Builder& builder)
    {
-      if(auto parsedTopLevelExpr = parseTopLevelExpr())
+      auto parsedTopLevelExpr = parseTopLevelExpr(builder);
+      if(!builder.isNull(parsedTopLevelExpr))
       {
-         if( const auto* topLevelExprIR = parsedTopLevelExpr->codeGen())
+         if (dumpAST_)
+            dumpAST(parsedTopLevelExpr);
+         
+         // the REPL runs the code of an expression seen before, if what it calls is the same
+         bool cached = !batchMode_ && jit_ && expressionCache_.isEnabled();
+         if (cached)
+         {
+            if (auto entryPoint = lookupExpression(parsedTopLevelExpr))
+            {
+               dumpStream_->flush();
+               fprintf(stderr, "Evaluated to %f\n", entryPoint());
+               return;
+            }
+         }
+         
+         if( const auto* topLevelExprIR = codeGenFunction(parsedTopLevelExpr))
          {
-            topLevelExprIR->print(llvm::errs());   //dump IR for the function
+            dump(topLevelExprIR);
+            
+            auto name = getFunctionName(parsedTopLevelExpr);
+            if (batchMode_)
+            {
+               // run once the module it belongs to is compiled
+               pendingExpressions_.push_back(name);
+               addToBatch();
+               return;
+            }
             
             //evaluation
-            std::unique_ptr<llvm::Module> module;
+            llvm::orc::ThreadSafeModule module;
             codeGenerator_.getModule(module);
             
-            auto H = jitCompiler_.addModule(module);
+            if (!jit_)
+            {
+               codeGenerator_.InitializeModuleAndPassManager();
+               return;
+            }
+            
+            // runs now, no stub for it
+            auto H = jitCompiler_.addModule(std::move(module), true);
             codeGenerator_.InitializeModuleAndPassManager();
             //InitializeModuleAndPassManager();
             
-            // Search the JIT for the __anon_expr symbol.
-            auto exprSymbol = jitCompiler_.findSymbol("__anon_expr");
-            assert(exprSymbol && "Function not found");
+            if (!H)
+               ++errorCount_; //reported by the jit
             
-            // Get the symbol's address and cast it to the right type (takes no
-            // arguments, returns a double) so we can call it as a native function.
-            double (*FP)() = (double (*)())(intptr_t)cantFail(exprSymbol.getAddress());
-            fprintf(stderr, "Evaluated to %f\n", FP());
+            auto entryPoint = H ? evaluate(name) : nullptr;
+            if (cached && entryPoint)
+            {
+               expressionCache_.insert(entryPoint, std::move(H));
+               return;
+            }
             
             // Delete the anonymous expression module from the JIT.
             jitCompiler_.removeModule(H);
          }
+         else
+         {
+            ++errorCount_;
+         }
       }
       else
       {
@@ -566,6 +959,97 @@ namespace parser
       }
    }
    
+   void Parser::dump(const llvm::Function* function)
+   {
+      switch (dumpLevel_)
+      {
+         case DumpNone:
+            break;
+         case DumpNames:
+            *dumpStream_ << function->getName() << "\n";
+            break;
+         case DumpFull:
+            function->print(*dumpStream_);
+            break;
+      }
+   }
+   
+   ExpressionCache::entry_point_t Parser::evaluate(util::Symbol name)
+   {
+      // what has been dumped so far comes before the output of the expression
+      dumpStream_->flush();
+      
+      // Search the JIT for the anonymous expression symbol.
+      auto exprSymbol = jitCompiler_.findSymbol(name.str().str());
+      if (!exprSymbol)
+      {
+         ++errorCount_; //reported by the jit
+         return nullptr;
+      }
+      
+      // Get the symbol's address and cast it to the right type (takes no
+      // arguments, returns a double) so we can call it as a native function.
+      double (*FP)() = (double (*)())(intptr_t)cantFail(exprSymbol.getAddress());
+      fprintf(stderr, "Evaluated to %f\n", FP());
+      return FP;
+   }
+   
+   void Parser::addToBatch()
+   {
+      ++batchItems_;
+      if (chunkSize_ != 0 && batchItems_ >= chunkSize_)
+         compileBatch();
+   }
+   
+   void Parser::flushBatch()
+   {
+      compileBatch();
+      runReadyExpressions();
+   }
+   
+   void Parser::compileBatch()
+   {
+      if (batchItems_ == 0)
+         return;
+      
+      llvm::orc::ThreadSafeModule module;
+      codeGenerator_.getModule(module);
+      
+      // not in the jit yet, nobody else is using the module
+      auto& batch = *module.getModuleUnlocked();
+      
+      // one run over the whole module: inlining and loop passes see every function of it.
+      // The lazy jit optimizes the functions it compiles instead
+      if (compileMode_ != jit::CompileMode::Lazy)
+         codeGenerator_.getOptimizer().optimizeModule(batch);
+      
+      if (moduleSink_)
+         moduleSink_(batch);
+      
+      bool added = jit_ && jitCompiler_.addModule(std::move(module));
+      if (jit_ && !added)
+         ++errorCount_;
+      codeGenerator_.InitializeModuleAndPassManager();
+      batchItems_ = 0;
+      
+      // the expressions of the previous chunk run while this one compiles on the pool
+      runReadyExpressions();
+      
+      // the expressions stay in the jit, they share the module with the definitions
+      if (added)
+         readyExpressions_.swap(pendingExpressions_);
+      
+      pendingExpressions_.clear();
+   }
+   
+   void Parser::runReadyExpressions()
+   {
+      for (auto name : readyExpressions_)
+         evaluate(name);
+      
+      readyExpressions_.clear();
+   }
+   
    ///
    /// main loop of parsing
    /// top ::= definition | external | expression | ';'
@@ -578,22 +1062,34 @@ namespace parser
          switch(curToken_)
          {
             case lexer::tok_eof:
+               flushBatch();
+               dumpStream_->flush();
                return;
             case ';':
                getNextToken();
                break;
             case lexer::tok_def:
-               handleDefinition();
+               useFlatAST_ ? handleDefinition(flatBuilder_) : handleDefinition(treeBuilder_);
                break;
             case lexer::tok_extern:
-               handleExtern();
+               useFlatAST_ ? handleExtern(flatBuilder_) : handleExtern(treeBuilder_);
                break;
             default:
-               handleTopLevelExpression();
+               useFlatAST_ ? handleTopLevelExpression(flatBuilder_) : handleTopLevelExpression(treeBuilder_);
                break;
          }
          
-         std::cout << "\n\n >>";
+         // what has been parsed is not needed anymore, an interactive input does not pile up tokens
+         // and the nodes of the item just compiled are freed at once
+         tokens_.release();
+         context_.reset();
+         flat_.clear();
+         
+         if (!batchMode_)
+         {
+            dumpStream_->flush();
+            std::cout << "\n\n >>";
+         }
          
       }
    }
@@ -10,14 +10,25 @@
 #define Parser_h
 
 #include <map>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "Lexer.h"
+#include "TokenStream.h"
 #include "AST.h"
+#include "ASTBuilder.h"
+#include "ASTContext.h"
+#include "FlatAST.h"
 #include "CompilerConfigurator.h"
 #include "CodeGenerator.h"
+#include "DumpLevel.h"
+#include "ExpressionCache.h"
 #include "JIT.h"
 
+#include "llvm/Support/raw_ostream.h"
+
 //namespace AST {
 //   class ExprAST;
 //   class PrototypeAST;
@@ -30,18 +41,16 @@ using namespace AST;
 
 namespace parser {
    
-   using expression_t = std::unique_ptr<ExprAST>;
-   using prototype_t = std::unique_ptr<PrototypeAST>;
-   using function_t = std::unique_ptr<FunctionAST>;
-   
    class Parser
    {
    public:
       
       ///
-      /// default constructor
+      /// @brief: construct a parser reading from the source passed (stdin by default).
+      ///         Every parser owns its lexer, code generator and jit: independent instances
+      ///         can run concurrently
       ///
-      explicit Parser();
+      explicit Parser(std::unique_ptr<lexer::InputSource> source = lexer::createStdinInputSource());
       
       ///
       /// delete copy ctor and copy assignment
@@ -54,86 +63,292 @@ namespace parser {
       ///
       
       int getNextToken();
+      
+      ///
+      /// @brief: continue parsing from a new input, the symbols already defined are kept
+      ///
+      void setInput(std::unique_ptr<lexer::InputSource> source);
+      
+      ///
+      /// @brief: scan the whole remaining input into the token stream before parsing it.
+      ///         Meant for files: lexing runs as a single batch loop. Interactive inputs are
+      ///         tokenized on demand instead
+      ///
+      void tokenizeInput();
+      
+      ///
+      /// @brief: lookahead, n tokens after the current one (0 is the token after curToken_)
+      ///
+      const lexer::TokenRecord& peekToken(std::size_t n = 0);
+      
+      ///
+      /// @brief: position of the current token in the token stream, seekToken() makes the token at
+      ///         that position the current one again
+      ///
+      std::size_t getTokenPosition() const;
+      void seekToken(std::size_t position);
+      
+      ///
+      /// @brief: parse every item into a flat AST and generate the IR from it rather than from
+      ///         the pointer tree
+      ///
+      void setFlatAST(bool enable);
+      
+      ///
+      /// @brief: batch compilation. The items of the input are gathered in one module, handed to the
+      ///         jit once every chunkSize top level items (0: once, at the end of the input), and the
+      ///         top level expressions run in order after their module is compiled. The expressions
+      ///         of a chunk run once the next chunk is handed to the jit, so that the compile threads
+      ///         work on it meanwhile.
+      ///         Off by default: the REPL compiles and runs every statement on its own. Turned off,
+      ///         the definitions that follow can replace earlier ones (see jit::JIT::setRedefinition)
+      ///
+      void setBatchMode(bool enable, std::size_t chunkSize = 0);
+      
+      ///
+      /// @brief: compile the module gathered so far and run its pending top level expressions
+      ///
+      void flushBatch();
+      
+      ///
+      /// @brief: options of the compilation, all on by default but the AST dump
+      ///
+      void setJit(bool enable);                   //run the top level expressions
+      void setCompileThreads(unsigned compileThreads); //see jit::JIT::setCompileThreads
+      
+      ///
+      /// @brief: top level expressions of the REPL kept compiled, 0 compiles every one again
+      ///         (see ExpressionCache, 1024 by default)
+      ///
+      void setExpressionCache(std::size_t capacity);
+      ExpressionCache& getExpressionCache();
+      
+      ///
+      /// @brief: when the jit compiles the functions (see jit::CompileMode), set before the level.
+      ///         Lazy: a function is optimized on its first call, on the compile threads, one at a time.
+      ///         Tiered: the IR is not optimized, the level and the pipeline are the ones of tier 1
+      ///
+      void setCompileMode(jit::CompileMode mode);
+      void setOptimizationLevel(optimizer::OptLevel level);
+      
+      ///
+      /// @brief: replace the module pipeline of the level (see Optimizer::setPipeline)
+      ///
+      bool setPassPipeline(const std::string& pipeline);
+      void setDumpAST(bool enable);               //print the AST of every item on the dump stream
+      
+      ///
+      /// @brief: what is printed of every function generated (nothing by default), and where.
+      ///         The default stream is a buffered stderr, flushed before a top level expression
+      ///         runs and at every prompt. The stream passed must outlive the parser
+      ///
+      void setDumpLevel(DumpLevel level);
+      void setDumpStream(llvm::raw_ostream& out);
+      
+      ///
+      /// @brief: called with every module of the batch mode before it goes to the jit
+      ///
+      void setModuleSink(std::function<void(llvm::Module&)> sink);
+      
+      jit::JIT& getJitCompiler();
+      code_generator::CodeGenerator& getCodeGenerator();
+      
+      ///
+      /// @brief: add a precompiled module (.bc or .ll) to the session: its definitions are
+      ///         available to what is parsed afterwards without being compiled again
+      ///
+      bool loadModule(const std::string& path);
+      
       void setTokenPrecedence(unsigned char, int);
-      int getTokenPrecedence();
+      
+      ///
+      /// @brief: errors reported so far: syntax errors, and items the code generator or the jit refused
+      ///
+      std::size_t getErrorCount() const { return errorCount_; }
+      
+      ///
+      /// @brief: precedence of the current token, -1 if it is not a binary operator
+      ///
+      int getTokenPrecedence() const { return precedence_.lookup(curToken_); }
 
-      expression_t error(const char* str);
-      prototype_t errorP(const char* str);
-            
+      ///
+      /// @brief: report a syntax error
+      ///
+      void error(const char* str);
+      
+      ///
+      /// The parse functions create the nodes through a builder (see ASTBuilder.h): the pointer
+      /// tree of AST::TreeBuilder, or the flat nodes of AST::FlatBuilder. A node is valid until
+      /// the next top level item
+      ///
+      
       ///numbexpr := number
-      expression_t parseNumberExpr();
+      template <typename Builder>
+      typename Builder::node_t parseNumberExpr(Builder& builder);
       
       ///parenexpr := '(' expression ')'
-      expression_t parseParentExpr();
+      template <typename Builder>
+      typename Builder::node_t parseParentExpr(Builder& builder);
       
       ///identifierexpr
       ///   := identifier
       //    := identifier '('expression')'
-      expression_t parseIdentifierExpr();
+      template <typename Builder>
+      typename Builder::node_t parseIdentifierExpr(Builder& builder);
       
       /// primary
       ///   ::= identifierexpr
       ///   ::= numberexpr
       ///   ::= parenexpr
-      expression_t parsePrimaryExpression();
+      template <typename Builder>
+      typename Builder::node_t parsePrimaryExpression(Builder& builder);
       
       /// unary operation
       ///  ::= primary
       ///  ::= '!' unary
-      expression_t parseUnary();
+      template <typename Builder>
+      typename Builder::node_t parseUnary(Builder& builder);
       
       /// binary operation
       ///   ::= ('+' primary)*
-      expression_t parseBinOpRHS(int exprPrec, expression_t lhs);
+      template <typename Builder>
+      typename Builder::node_t parseBinOpRHS(Builder& builder, int exprPrec, typename Builder::node_t lhs);
       
       /// expression
       ///   ::= primary binoprhs
       ///
-      expression_t parseExpression();
+      template <typename Builder>
+      typename Builder::node_t parseExpression(Builder& builder);
       
       /// prototype
       ///   ::= id '(' id* ')'
       ///   ::= unary  LETTER number? (id)
       ///   ::= binary LETTER number? (id, id)
-      prototype_t parsePrototype();
+      template <typename Builder>
+      typename Builder::prototype_t parsePrototype(Builder& builder);
       
       /// definition ::= 'def' prototype expression
-      function_t parseDefinition();
+      template <typename Builder>
+      typename Builder::function_t parseDefinition(Builder& builder);
 
       /// toplevelexpr ::= expression
-      function_t parseTopLevelExpr();
+      template <typename Builder>
+      typename Builder::function_t parseTopLevelExpr(Builder& builder);
       
       /// external ::= 'extern' prototype
-      prototype_t parseExtern();
+      template <typename Builder>
+      typename Builder::prototype_t parseExtern(Builder& builder);
       
       /// ifexpr ::= 'if' expression 'then' expression 'else' expression
-      expression_t parseIfExpr();
+      template <typename Builder>
+      typename Builder::node_t parseIfExpr(Builder& builder);
       
       /// forexpr ::= 'for' identifier '=' expr ',' expr (',' expr)? 'in' expression
-      expression_t parseForExpr();
+      template <typename Builder>
+      typename Builder::node_t parseForExpr(Builder& builder);
       
       /// varexpr ::= 'var' identifier ('=' expression)?
       //  (',' identifier ('=' expression)?)* 'in' expression
-      expression_t parseVarExpr();
+      template <typename Builder>
+      typename Builder::node_t parseVarExpr(Builder& builder);
       
       ///
       /// Top Level parsing
       ///
-      void handleDefinition();
-      void handleExtern();
-      void handleTopLevelExpression();
+      template <typename Builder> void handleDefinition(Builder& builder);
+      template <typename Builder> void handleExtern(Builder& builder);
+      template <typename Builder> void handleTopLevelExpression(Builder& builder);
       
       void mainLoop();
       
    private:
       
+      ///
+      /// payload of the current token
+      ///
+      double getTokenNumber() const;
+      util::Symbol getTokenSymbol() const;
+      const std::string& getTokenError() const;
+      
+      ///
+      /// @brief: what the handlers of the top level items do with a node, for either builder
+      ///
+      Function* codeGenFunction(const FunctionAST* function);
+      Function* codeGenFunction(AST::NodeId function);
+      Function* codeGenPrototype(const PrototypeAST* prototype);
+      Function* codeGenPrototype(AST::NodeId prototype);
+      void cachePrototype(const PrototypeAST* prototype);
+      void cachePrototype(AST::NodeId prototype);
+      util::Symbol getFunctionName(const FunctionAST* function) const;
+      util::Symbol getFunctionName(AST::NodeId function) const;
+      ExpressionCache::entry_point_t lookupExpression(const FunctionAST* function);
+      ExpressionCache::entry_point_t lookupExpression(AST::NodeId function);
+      void dumpAST(const ExprAST* node);
+      void dumpAST(AST::NodeId node);
+      
+      ///
+      /// @brief: print a generated function as the dump level says
+      ///
+      void dump(const llvm::Function* function);
+      
+      ///
+      /// @brief: run a compiled top level expression and print its value, returns its code
+      ///         (nullptr if it is not in the jit)
+      ///
+      ExpressionCache::entry_point_t evaluate(util::Symbol name);
+      
+      ///
+      /// @brief: account a compiled item to the current batch, hand it to the jit when the chunk is full
+      ///
+      void addToBatch();
+      
+      ///
+      /// @brief: hand the module gathered so far to the jit, then run the expressions of the
+      ///         previous one. Its own expressions are ready to run after this
+      ///
+      void compileBatch();
+      void runReadyExpressions();
+      
+      ///
+      /// @brief: the optimizer the level and the pipeline are meant for
+      ///
+      optimizer::Optimizer& getOptimizer();
+      
+      
+      util::Interner interner_; //identifiers of this compilation, shared by lexer, AST and code generator
       code_generator::CodeGeneratorImpl codeGenerator_;
       jit::JIT jitCompiler_;
 
       
       int curToken_;
+      lexer::TokenRecord token_; //current token, curToken_ is its kind
       util::CompilerConfigurator configurator_;
       std::unique_ptr<lexer::Lexer> lexer_;
+      lexer::TokenStream tokens_;
+      const util::PrecedenceTable& precedence_; //owned by the code generator
+      AST::ASTContext context_; //nodes of the top level item being compiled
+      AST::FlatAST flat_; //the same, when useFlatAST_
+      AST::TreeBuilder treeBuilder_;
+      AST::FlatBuilder flatBuilder_;
+      bool useFlatAST_;
+      
+      bool jit_;
+      jit::CompileMode compileMode_;
+      std::mutex optimizerMutex_; //the jit optimizes the functions of the lazy mode on its threads
+      bool dumpAST_;
+      DumpLevel dumpLevel_;
+      llvm::raw_fd_ostream bufferedErrs_; //default dump stream
+      llvm::raw_ostream* dumpStream_;
+      std::function<void(llvm::Module&)> moduleSink_;
+      
+      bool batchMode_;
+      std::size_t chunkSize_;
+      std::size_t batchItems_; //items in the module being gathered
+      std::vector<util::Symbol> pendingExpressions_; //top level expressions waiting for their module
+      std::vector<util::Symbol> readyExpressions_; //expressions of the module last handed to the jit
+      std::size_t errorCount_; //items the parser, the code generator or the jit refused
+      ExpressionCache expressionCache_; //the REPL only
+      unsigned anonExprCount_;
       
    };
    
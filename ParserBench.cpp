@@ -0,0 +1,223 @@
+//
+//  ParserBench.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 16/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+//  Parser benchmark on expression dense input: definitions whose bodies are long chains of binary
+//  operators. Reports the parse time of the whole input, and the precedence lookups of its tokens
+//  through util::PrecedenceTable against the std::map behind a virtual call the parser used before.
+//  The input is tokenized before the clock starts.
+//
+//  usage: parserbench.out [functions] [passes]   (default 20000 functions, 5 passes)
+//
+
+#include "ASTBuilder.h"
+#include "ASTContext.h"
+#include "InputSource.h"
+#include "Interner.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "PrecedenceTable.h"
+
+#include "llvm/Support/TargetSelect.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+   using milliseconds_t = std::chrono::duration<double, std::milli>;
+
+   const char Operators[] = {'+', '-', '*', '<'};
+
+   ///
+   /// @brief: operand ::= name | number | '(' operand op operand ')', the same for every run
+   ///
+   void generateOperand(std::mt19937& random, std::string& text, int depth)
+   {
+      switch (random() % (depth ? 4 : 3))
+      {
+         case 0: text += "a"; break;
+         case 1: text += "b"; break;
+         case 2: text += std::to_string(random() % 100); break;
+         default:
+            text += '(';
+            generateOperand(random, text, depth - 1);
+            text += ' ';
+            text += Operators[random() % 4];
+            text += ' ';
+            generateOperand(random, text, depth - 1);
+            text += ')';
+      }
+   }
+
+   std::string generate(std::size_t functions)
+   {
+      std::mt19937 random(2017);
+      std::string text;
+      for (std::size_t i = 0; i < functions; ++i)
+      {
+         text += "def e" + std::to_string(i) + "(a b) ";
+         generateOperand(random, text, 2);
+         for (int term = 0; term < 24; ++term)
+         {
+            text += ' ';
+            text += Operators[random() % 4];
+            text += ' ';
+            generateOperand(random, text, 2);
+         }
+         text += ";\n";
+      }
+      return text;
+   }
+
+   ///
+   /// @brief: the lookup of the parser before util::PrecedenceTable: an ascii test, then a
+   ///         std::map behind the virtual interface of the code generator
+   ///
+   class MapPrecedence
+   {
+   public:
+
+      virtual ~MapPrecedence() = default;
+
+      virtual int getOperatorPrecedence(unsigned char token) const
+      {
+         auto it = precedence_.find(token);
+         return it != precedence_.end() ? it->second : -1;
+      }
+
+      void set(unsigned char token, int precedence) { precedence_[token] = precedence; }
+
+   private:
+
+      std::map<unsigned char, int> precedence_;
+   };
+
+   int lookup(const MapPrecedence& precedence, int token)
+   {
+      if (!isascii(token))
+         return -1;
+
+      return precedence.getOperatorPrecedence(token);
+   }
+
+   int lookup(const util::PrecedenceTable& precedence, int token)
+   {
+      return precedence.lookup(token);
+   }
+
+   ///
+   /// @brief: every token looked up passes times, returns the best time
+   ///
+   template <typename Table>
+   double timeLookups(const Table& table, const std::vector<int>& tokens, int passes, long& checksum)
+   {
+      double best = 0;
+      for (int pass = 0; pass < passes; ++pass)
+      {
+         long sum = 0;
+         auto start = std::chrono::steady_clock::now();
+         for (int token : tokens)
+            sum += lookup(table, token);
+         milliseconds_t elapsed = std::chrono::steady_clock::now() - start;
+
+         checksum = sum;
+         if (pass == 0 || elapsed.count() < best)
+            best = elapsed.count();
+      }
+      return best;
+   }
+}
+
+int main(int argc, const char* argv[])
+{
+   // the jit of the parser needs the target, as in Driver::go()
+   llvm::InitializeNativeTarget();
+   llvm::InitializeNativeTargetAsmPrinter();
+
+   std::size_t functions = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+   if (functions == 0)
+      functions = 1;
+   int passes = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+   auto text = generate(functions);
+
+   // the precedences of Driver::go()
+   const std::pair<unsigned char, int> precedences[] = {{'=', 2}, {'<', 10}, {'+', 20}, {'-', 30}, {'*', 40}};
+
+   // parse: the nodes of every definition are released after it, as in Parser::mainLoop()
+   double bestParse = 0;
+   for (int pass = 0; pass < passes; ++pass)
+   {
+      parser::Parser parser(std::make_unique<lexer::StringInputSource>(text));
+      for (const auto& precedence : precedences)
+         parser.setTokenPrecedence(precedence.first, precedence.second);
+      parser.setJit(false);
+      parser.tokenizeInput();
+
+      AST::ASTContext context;
+      AST::TreeBuilder builder(context);
+      std::size_t parsed = 0;
+
+      // every definition ends with ';', the token after it is the next 'def'
+      auto start = std::chrono::steady_clock::now();
+      for (int token = parser.getNextToken(); token == lexer::tok_def; token = parser.getNextToken())
+      {
+         if (!parser.parseDefinition(builder))
+            break;
+         context.reset();
+         ++parsed;
+      }
+      milliseconds_t elapsed = std::chrono::steady_clock::now() - start;
+
+      if (parsed != functions)
+      {
+         std::cerr << "Error: parsed " << parsed << " definitions of " << functions << "\n";
+         return 1;
+      }
+      if (pass == 0 || elapsed.count() < bestParse)
+         bestParse = elapsed.count();
+   }
+
+   // the tokens the parser looks up
+   std::vector<int> tokens;
+   util::Interner interner;
+   lexer::Lexer lexer(interner, std::make_unique<lexer::StringInputSource>(text));
+   for (int token = lexer.gettok(); token != lexer::tok_eof; token = lexer.gettok())
+      tokens.push_back(token);
+
+   util::PrecedenceTable table;
+   MapPrecedence map;
+   for (const auto& precedence : precedences)
+   {
+      table.set(precedence.first, precedence.second);
+      map.set(precedence.first, precedence.second);
+   }
+
+   long tableSum = 0, mapSum = 0;
+   double tableTime = timeLookups(table, tokens, passes, tableSum);
+   double mapTime = timeLookups(map, tokens, passes, mapSum);
+   if (tableSum != mapSum)
+   {
+      std::cerr << "Error: the lookups disagree\n";
+      return 1;
+   }
+
+   std::cout << "input: " << functions << " functions, " << text.size() << " bytes, " << tokens.size() << " tokens\n"
+             << "parse: " << bestParse << " ms, " << bestParse * 1e6 / tokens.size() << " ns per token\n"
+             << "precedence lookups: table " << tableTime * 1e6 / tokens.size() << " ns, "
+             << "map " << mapTime * 1e6 / tokens.size() << " ns per token ("
+             << mapTime / tableTime << "x)\n";
+   return 0;
+}
@@ -0,0 +1,71 @@
+//
+//  PrecedenceTable.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef PrecedenceTable_h
+#define PrecedenceTable_h
+
+#include <array>
+#include <cstdint>
+
+namespace util
+{
+
+   ///
+   /// @brief: precedence of the binary operators, one entry per byte value (-1 if the token is not a
+   ///         binary operator). Operators are ascii characters, so only [0, 128) is ever set: the
+   ///         tokens of the lexer are either ascii characters or negative values, whose low byte
+   ///         falls in [128, 256), and the lookup is a plain index with no branch.
+   ///         The version counts the updates, it tells a client whether the precedences it saw
+   ///         are still the ones in use in this compilation session
+   ///
+   class PrecedenceTable
+   {
+   public:
+
+      using version_t = std::uint64_t;
+
+      PrecedenceTable() : version_(0)
+      {
+         table_.fill(-1);
+      }
+
+      PrecedenceTable(const PrecedenceTable&) = delete;
+      PrecedenceTable& operator=(const PrecedenceTable&) = delete;
+
+      int lookup(int token) const
+      {
+         return table_[static_cast<unsigned char>(token)];
+      }
+
+      ///
+      /// @brief: set the precedence of an operator, non ascii tokens are refused
+      ///
+      bool set(unsigned char token, int precedence)
+      {
+         if (token >= 128)
+            return false;
+
+         if (table_[token] != precedence)
+         {
+            table_[token] = precedence;
+            ++version_;
+         }
+         return true;
+      }
+
+      version_t getVersion() const { return version_; }
+
+   private:
+
+      std::array<int, 256> table_;
+      version_t version_;
+   };
+
+}
+
+#endif /* PrecedenceTable_h */
@@ -0,0 +1,264 @@
+//
+//  ScanKernels.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#include "ScanKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LEXER_SCAN_X86 1
+#include <immintrin.h>
+#define LEXER_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace lexer
+{
+   namespace
+   {
+      using kernel_t = const char* (*)(const char*, const char*);
+
+      ///
+      /// scalar predicates, same classification as the C locale isspace/isalnum
+      ///
+
+      inline bool isSpaceChar(unsigned char c)
+      {
+         return c == ' ' || (c >= '\t' && c <= '\r');
+      }
+
+      inline bool isIdentifierChar(unsigned char c)
+      {
+         return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+      }
+
+      ///
+      /// @brief: every kernel describes the bytes of its run. The vector versions return a bit mask
+      ///         of the bytes that stop the run
+      ///
+      struct Whitespace
+      {
+         static bool inRun(unsigned char c) { return isSpaceChar(c); }
+#ifdef LEXER_SCAN_X86
+#ifdef __SSE2__
+         static unsigned stop(__m128i v);
+#endif
+         LEXER_AVX2 static unsigned stop(__m256i v);
+#endif
+      };
+
+      struct LineEnd
+      {
+         static bool inRun(unsigned char c) { return c != '\n' && c != '\r'; }
+#ifdef LEXER_SCAN_X86
+#ifdef __SSE2__
+         static unsigned stop(__m128i v);
+#endif
+         LEXER_AVX2 static unsigned stop(__m256i v);
+#endif
+      };
+
+      struct Identifier
+      {
+         static bool inRun(unsigned char c) { return isIdentifierChar(c); }
+#ifdef LEXER_SCAN_X86
+#ifdef __SSE2__
+         static unsigned stop(__m128i v);
+#endif
+         LEXER_AVX2 static unsigned stop(__m256i v);
+#endif
+      };
+
+      struct Number
+      {
+         static bool inRun(unsigned char c) { return isIdentifierChar(c) || c == '.'; }
+#ifdef LEXER_SCAN_X86
+#ifdef __SSE2__
+         static unsigned stop(__m128i v);
+#endif
+         LEXER_AVX2 static unsigned stop(__m256i v);
+#endif
+      };
+
+      template <typename Kernel>
+      const char* scalarRun(const char* p, const char* end)
+      {
+         while (p != end && Kernel::inRun(static_cast<unsigned char>(*p)))
+            ++p;
+         return p;
+      }
+
+#ifdef LEXER_SCAN_X86
+
+#ifdef __SSE2__
+      ///
+      /// SSE2, 16 bytes at a time. Signed compares are fine: bytes >= 0x80 are negative and
+      /// never fall in an ascii range
+      ///
+
+      inline __m128i inRange(__m128i v, char lo, char hi)
+      {
+         return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                              _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+      }
+
+      inline __m128i isAlnum(__m128i v)
+      {
+         __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+         return _mm_or_si128(inRange(v, '0', '9'), inRange(lower, 'a', 'z'));
+      }
+
+      inline unsigned stopWhereNot(__m128i run)
+      {
+         return ~static_cast<unsigned>(_mm_movemask_epi8(run)) & 0xFFFFu;
+      }
+
+      unsigned Whitespace::stop(__m128i v)
+      {
+         return stopWhereNot(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), inRange(v, '\t', '\r')));
+      }
+
+      unsigned LineEnd::stop(__m128i v)
+      {
+         return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                               _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+      }
+
+      unsigned Identifier::stop(__m128i v)
+      {
+         return stopWhereNot(isAlnum(v));
+      }
+
+      unsigned Number::stop(__m128i v)
+      {
+         return stopWhereNot(_mm_or_si128(isAlnum(v), _mm_cmpeq_epi8(v, _mm_set1_epi8('.'))));
+      }
+
+      template <typename Kernel>
+      const char* sse2Run(const char* p, const char* end)
+      {
+         while (end - p >= 16)
+         {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            if (unsigned stop = Kernel::stop(v))
+               return p + __builtin_ctz(stop);
+            p += 16;
+         }
+         return scalarRun<Kernel>(p, end);
+      }
+#endif
+
+      ///
+      /// AVX2, 32 bytes at a time
+      ///
+
+      LEXER_AVX2 inline __m256i inRange(__m256i v, char lo, char hi)
+      {
+         return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                                 _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+      }
+
+      LEXER_AVX2 inline __m256i isAlnum(__m256i v)
+      {
+         __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+         return _mm256_or_si256(inRange(v, '0', '9'), inRange(lower, 'a', 'z'));
+      }
+
+      LEXER_AVX2 inline unsigned stopWhereNot(__m256i run)
+      {
+         return ~static_cast<unsigned>(_mm256_movemask_epi8(run));
+      }
+
+      LEXER_AVX2 unsigned Whitespace::stop(__m256i v)
+      {
+         return stopWhereNot(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), inRange(v, '\t', '\r')));
+      }
+
+      LEXER_AVX2 unsigned LineEnd::stop(__m256i v)
+      {
+         return _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                                     _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+      }
+
+      LEXER_AVX2 unsigned Identifier::stop(__m256i v)
+      {
+         return stopWhereNot(isAlnum(v));
+      }
+
+      LEXER_AVX2 unsigned Number::stop(__m256i v)
+      {
+         return stopWhereNot(_mm256_or_si256(isAlnum(v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'))));
+      }
+
+      template <typename Kernel>
+      LEXER_AVX2 const char* avx2Run(const char* p, const char* end)
+      {
+         while (end - p >= 32)
+         {
+            auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            if (unsigned stop = Kernel::stop(v))
+               return p + __builtin_ctz(stop);
+            p += 32;
+         }
+         return scalarRun<Kernel>(p, end);
+      }
+
+#endif
+
+      struct KernelTable
+      {
+         kernel_t whitespace;
+         kernel_t lineEnd;
+         kernel_t identifier;
+         kernel_t number;
+         const char* name;
+      };
+
+      KernelTable selectKernels()
+      {
+#ifdef LEXER_SCAN_X86
+         __builtin_cpu_init();
+         if (__builtin_cpu_supports("avx2"))
+            return {avx2Run<Whitespace>, avx2Run<LineEnd>, avx2Run<Identifier>, avx2Run<Number>, "avx2"};
+#ifdef __SSE2__
+         return {sse2Run<Whitespace>, sse2Run<LineEnd>, sse2Run<Identifier>, sse2Run<Number>, "sse2"};
+#endif
+#endif
+         return {scalarRun<Whitespace>, scalarRun<LineEnd>, scalarRun<Identifier>, scalarRun<Number>, "scalar"};
+      }
+
+      const KernelTable& kernels()
+      {
+         static const KernelTable table = selectKernels();
+         return table;
+      }
+   }
+
+   const char* skipWhitespace(const char* p, const char* end)
+   {
+      return kernels().whitespace(p, end);
+   }
+
+   const char* findLineEnd(const char* p, const char* end)
+   {
+      return kernels().lineEnd(p, end);
+   }
+
+   const char* skipIdentifier(const char* p, const char* end)
+   {
+      return kernels().identifier(p, end);
+   }
+
+   const char* skipNumber(const char* p, const char* end)
+   {
+      return kernels().number(p, end);
+   }
+
+   const char* getScanKernelsName()
+   {
+      return kernels().name;
+   }
+
+}
@@ -0,0 +1,41 @@
+//
+//  ScanKernels.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef ScanKernels_h
+#define ScanKernels_h
+
+namespace lexer
+{
+
+   ///
+   /// @brief: scanning kernels used by the lexer over the source window.
+   ///         Every kernel returns the first position in [p, end) that does not belong to the run
+   ///         (or end). They work 16 (SSE2) or 32 (AVX2) bytes at a time, the implementation is
+   ///         chosen at runtime from the cpu features, with a scalar fallback
+   ///
+
+   /// run of ' ', '\t', '\n', '\v', '\f', '\r'
+   const char* skipWhitespace(const char* p, const char* end);
+
+   /// position of the next '\n' or '\r'
+   const char* findLineEnd(const char* p, const char* end);
+
+   /// run of [a-zA-Z0-9]
+   const char* skipIdentifier(const char* p, const char* end);
+
+   /// run of [a-zA-Z0-9.]
+   const char* skipNumber(const char* p, const char* end);
+
+   ///
+   /// @brief: name of the implementation selected ("avx2", "sse2" or "scalar")
+   ///
+   const char* getScanKernelsName();
+
+}
+
+#endif /* ScanKernels_h */
@@ -0,0 +1,119 @@
+//
+//  TokenStream.cpp
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#include "TokenStream.h"
+
+#include <algorithm>
+
+namespace lexer
+{
+
+   TokenStream::TokenStream(Lexer& lexer) :
+   lexer_(lexer),
+   base_(0),
+   next_(0),
+   complete_(false)
+   {}
+
+   void TokenStream::tokenizeAll()
+   {
+      while (!complete_)
+         scan();
+   }
+
+   const TokenRecord& TokenStream::peek(std::size_t n)
+   {
+      fill(next_ + n);
+
+      // once the input is over, every position past the end reads as the final tok_eof
+      auto index = std::min(next_ + n - base_, tokens_.size() - 1);
+      return tokens_[index];
+   }
+
+   const TokenRecord& TokenStream::next()
+   {
+      const TokenRecord& token = peek();
+      ++next_;
+      return token;
+   }
+
+   std::size_t TokenStream::position() const
+   {
+      return next_;
+   }
+
+   void TokenStream::seek(std::size_t position)
+   {
+      next_ = std::max(position, base_);
+   }
+
+   void TokenStream::release()
+   {
+      // a fully scanned input keeps all its tokens (and erasing from the front would be quadratic)
+      if (complete_)
+         return;
+
+      auto consumed = std::min(next_ - base_, tokens_.size());
+      tokens_.erase(tokens_.begin(), tokens_.begin() + consumed);
+      base_ += consumed;
+   }
+
+   void TokenStream::reset()
+   {
+      tokens_.clear();
+      errors_.clear();
+      base_ = 0;
+      next_ = 0;
+      complete_ = false;
+   }
+
+   const std::string& TokenStream::getError(const TokenRecord& token) const
+   {
+      return errors_[token.error];
+   }
+
+   void TokenStream::fill(std::size_t position)
+   {
+      while (!complete_ && base_ + tokens_.size() <= position)
+         scan();
+   }
+
+   void TokenStream::scan()
+   {
+      TokenRecord token;
+      token.kind = lexer_.gettok();
+      token.offset = static_cast<std::uint32_t>(lexer_.getTokenOffset());
+
+      switch (token.kind)
+      {
+         case tok_number:
+            token.number = lexer_.getNum();
+            break;
+
+         case tok_identifier:
+            token.symbol = lexer_.getId().getId();
+            break;
+
+         case tok_error:
+            token.error = static_cast<std::uint32_t>(errors_.size());
+            errors_.push_back(lexer_.getError());
+            break;
+
+         case tok_eof:
+            complete_ = true;
+            // fall through
+
+         default:
+            token.number = 0;
+            break;
+      }
+
+      tokens_.push_back(token);
+   }
+
+}
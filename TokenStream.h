@@ -0,0 +1,112 @@
+//
+//  TokenStream.h
+//  llvm
+//
+//  Created by Nicola Cabiddu on 15/10/2026.
+//  Copyright © 2017 Nicola Cabiddu. All rights reserved.
+//
+
+#ifndef TokenStream_h
+#define TokenStream_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Lexer.h"
+
+namespace lexer
+{
+
+   ///
+   /// @brief: compact record of a scanned token. The payload depends on the kind:
+   ///         tok_number  -> number
+   ///         tok_identifier -> symbol, id in the interner of the lexer
+   ///         tok_error   -> error, index of the message in the token stream
+   ///
+   struct TokenRecord
+   {
+      std::int32_t kind;
+      std::uint32_t offset; //first byte of the token in the input
+
+      union
+      {
+         double number;
+         std::uint32_t symbol;
+         std::uint32_t error;
+      };
+   };
+
+   static_assert(sizeof(TokenRecord) == 16, "tokens are expected to stay compact");
+
+   ///
+   /// @brief: array of the tokens scanned by a lexer, with unlimited lookahead and rewind.
+   ///         Tokens are either scanned all at once (tokenizeAll, for whole files) or on demand, as
+   ///         far as the parser looks ahead, so that an interactive input is never read beyond the
+   ///         line being parsed. Positions are absolute from the start of the input
+   ///
+   class TokenStream
+   {
+   public:
+
+      explicit TokenStream(Lexer& lexer);
+
+      TokenStream(const TokenStream&) = delete;
+      TokenStream& operator=(const TokenStream&) = delete;
+
+      ///
+      /// @brief: scan the rest of the input in a single pass
+      ///
+      void tokenizeAll();
+
+      ///
+      /// @brief: token n positions after the next one, without consuming anything.
+      ///         Past the end of the input tok_eof is returned
+      ///
+      const TokenRecord& peek(std::size_t n = 0);
+
+      ///
+      /// @brief: consume the next token
+      ///
+      const TokenRecord& next();
+
+      ///
+      /// @brief: position of the next token to be consumed. Seeking back is allowed down to the
+      ///         first token not released yet
+      ///
+      std::size_t position() const;
+      void seek(std::size_t position);
+
+      ///
+      /// @brief: drop the tokens already consumed, the positions after them stay valid.
+      ///         Only tokens scanned on demand are released, a fully scanned input is kept whole
+      ///
+      void release();
+
+      ///
+      /// @brief: forget every token, the lexer has been given a new input
+      ///
+      void reset();
+
+      const std::string& getError(const TokenRecord& token) const;
+
+   private:
+
+      Lexer& lexer_;
+      std::vector<TokenRecord> tokens_;
+      std::vector<std::string> errors_;
+      std::size_t base_; //position of tokens_[0]
+      std::size_t next_; //position of the next token to consume
+      bool complete_; //tok_eof has been scanned
+
+      ///
+      /// @brief: scan tokens until the position passed is available or the input ends
+      ///
+      void fill(std::size_t position);
+      void scan();
+   };
+
+}
+
+#endif /* TokenStream_h */
@@ -6,14 +6,215 @@
 //  Copyright © 2016 Nicola Cabiddu. All rights reserved.
 //
 
+#include <cstdlib>
 #include <iostream>
+#include <string>
 #include "Driver.h"
+#include "JIT.h"
+
+static void usage(const char* program)
+{
+   std::cerr << "usage: " << program << " [options] [file...]\n"
+             << "  -O0 .. -O3, -Os             optimization level (default -O2)\n"
+             << "  --passes=<pipeline>         module pipeline replacing the one of the level (opt -passes syntax)\n"
+             << "  --emit=<kind>[,<kind>...]   write the compiled modules to disk as obj, asm, ir or bc (default none)\n"
+             << "  --load=<file>               add a module emitted as bc or ir before the inputs\n"
+             << "  -o <file>                   name of the emitted file (single input and kind only)\n"
+             << "  --jit, --no-jit             run the top level expressions (default --jit, --no-jit with --emit)\n"
+             << "  --lazy                      compile a function on its first call (not with --emit)\n"
+             << "  --tiered                    compile at once unoptimized, optimize the functions called often (not with --emit)\n"
+             << "  --tier-threshold=<n>        calls after which --tiered optimizes a function (default 1000)\n"
+             << "  --object-cache[=<dir>]      reuse the objects compiled by earlier runs (default dir: user cache)\n"
+             << "  --object-cache-size=<mb>    bound of the object cache directory (default 512)\n"
+             << "  --expr-cache=<n>            expressions the REPL keeps compiled to run again (default 1024, 0 none)\n"
+             << "  --compile-threads=<n>       threads compiling for the jit (default one per core, 0 none)\n"
+             << "  --dump=none|names|full      print nothing (default), the name or the IR of every function\n"
+             << "  --dump-file=<file>          write the dump to a file rather than stderr\n"
+             << "  --quiet                     same as --dump=none\n"
+             << "  --flat-ast                  parse into a flat AST and generate the IR from it\n"
+             << "  --debug                     print the AST of every definition\n"
+             << "  --stats                     print the counters of the session at exit\n"
+             << "the standard input is compiled when no file is given\n";
+}
 
 int main(int argc, const char * argv[]) {
    
    driver::DriverConfiguration cnf;
-   driver::Driver driver{cnf};
-   driver.go();
+   bool jitOption = false; //--jit or --no-jit given
+   
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string arg = argv[i];
+      
+      if (arg == "--jit" || arg == "--no-jit")
+      {
+         cnf.enableJit_ = arg == "--jit";
+         jitOption = true;
+      }
+      else if (arg == "--lazy")
+         cnf.compileMode_ = jit::CompileMode::Lazy;
+      else if (arg == "--tiered")
+         cnf.compileMode_ = jit::CompileMode::Tiered;
+      else if (arg.compare(0, 17, "--tier-threshold=") == 0)
+      {
+         auto count = arg.substr(17);
+         char* end = nullptr;
+         auto calls = std::strtoul(count.c_str(), &end, 10);
+         if (count.empty() || *end != '\0' || calls == 0)
+         {
+            std::cerr << "Error: invalid tier threshold " << count << "\n";
+            return 1;
+         }
+         cnf.tierUpThreshold_ = calls;
+      }
+      else if (arg == "--object-cache")
+         cnf.objectCache_ = true;
+      else if (arg.compare(0, 15, "--object-cache=") == 0)
+      {
+         cnf.objectCache_ = true;
+         cnf.objectCacheDir_ = arg.substr(15);
+      }
+      else if (arg.compare(0, 20, "--object-cache-size=") == 0)
+      {
+         auto size = arg.substr(20);
+         char* end = nullptr;
+         auto megabytes = std::strtoul(size.c_str(), &end, 10);
+         if (size.empty() || *end != '\0' || megabytes == 0)
+         {
+            std::cerr << "Error: invalid object cache size " << size << "\n";
+            return 1;
+         }
+         cnf.objectCacheSize_ = megabytes << 20;
+      }
+      else if (arg.compare(0, 13, "--expr-cache=") == 0)
+      {
+         auto count = arg.substr(13);
+         char* end = nullptr;
+         auto entries = std::strtoul(count.c_str(), &end, 10);
+         if (count.empty() || *end != '\0')
+         {
+            std::cerr << "Error: invalid expression cache size " << count << "\n";
+            return 1;
+         }
+         cnf.expressionCacheSize_ = entries;
+      }
+      else if (arg.compare(0, 18, "--compile-threads=") == 0)
+      {
+         auto count = arg.substr(18);
+         char* end = nullptr;
+         auto threads = std::strtoul(count.c_str(), &end, 10);
+         if (count.empty() || *end != '\0')
+         {
+            std::cerr << "Error: invalid number of threads " << count << "\n";
+            return 1;
+         }
+         cnf.compileThreads_ = static_cast<unsigned>(threads);
+      }
+      else if (arg == "--quiet")
+         cnf.dumpLevel_ = parser::DumpNone;
+      else if (arg.compare(0, 7, "--dump=") == 0)
+      {
+         auto level = arg.substr(7);
+         if (level == "none")
+            cnf.dumpLevel_ = parser::DumpNone;
+         else if (level == "names")
+            cnf.dumpLevel_ = parser::DumpNames;
+         else if (level == "full")
+            cnf.dumpLevel_ = parser::DumpFull;
+         else
+         {
+            std::cerr << "Error: unknown dump level " << level << "\n";
+            return 1;
+         }
+      }
+      else if (arg.compare(0, 12, "--dump-file=") == 0)
+         cnf.dumpFile_ = arg.substr(12);
+      else if (arg == "--flat-ast")
+         cnf.flatAST_ = true;
+      else if (arg == "--debug")
+         cnf.enableDebug_ = true;
+      else if (arg == "--stats")
+         cnf.printStats_ = true;
+      else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3')
+      {
+         cnf.optLevel_ = arg[2] - '0';
+         cnf.enableOpt_ = cnf.optLevel_ > 0;
+         cnf.optimizeSize_ = false;
+      }
+      else if (arg == "-Os")
+      {
+         cnf.optLevel_ = 2;
+         cnf.enableOpt_ = true;
+         cnf.optimizeSize_ = true;
+      }
+      else if (arg.compare(0, 9, "--passes=") == 0)
+         cnf.passPipeline_ = arg.substr(9);
+      else if (arg.compare(0, 7, "--emit=") == 0)
+      {
+         // a list of kinds, each one written next to the others
+         cnf.saveAsObjectFile_ = cnf.saveAsAsmFile_ = cnf.saveAsIRFile_ = cnf.saveAsBitcodeFile_ = false;
+         auto kinds = arg.substr(7) + ',';
+         for (std::size_t begin = 0, end; (end = kinds.find(',', begin)) != std::string::npos; begin = end + 1)
+         {
+            auto kind = kinds.substr(begin, end - begin);
+            if (kind == "obj")
+               cnf.saveAsObjectFile_ = true;
+            else if (kind == "asm")
+               cnf.saveAsAsmFile_ = true;
+            else if (kind == "ir")
+               cnf.saveAsIRFile_ = true;
+            else if (kind == "bc")
+               cnf.saveAsBitcodeFile_ = true;
+            else if (kind != "none")
+            {
+               std::cerr << "Error: unknown output kind " << kind << "\n";
+               return 1;
+            }
+         }
+      }
+      else if (arg.compare(0, 7, "--load=") == 0)
+         cnf.loadFiles_.push_back(arg.substr(7));
+      else if (arg == "-o")
+      {
+         if (++i == argc)
+         {
+            std::cerr << "Error: -o needs a file name\n";
+            return 1;
+         }
+         cnf.outputFile_ = argv[i];
+      }
+      else if (arg == "-h" || arg == "--help")
+      {
+         usage(argv[0]);
+         return 0;
+      }
+      else if (arg.size() > 1 && arg[0] == '-')
+      {
+         std::cerr << "Error: unknown option " << arg << "\n";
+         usage(argv[0]);
+         return 1;
+      }
+      else
+         cnf.inputFiles_.push_back(arg);
+   }
    
-   return 0;
+   if (!cnf.outputFile_.empty() && cnf.inputFiles_.size() > 1)
+   {
+      std::cerr << "Error: -o needs a single input file\n";
+      return 1;
+   }
+   
+   if (!cnf.outputFile_.empty() && cnf.saveAsObjectFile_ + cnf.saveAsAsmFile_ + cnf.saveAsIRFile_ + cnf.saveAsBitcodeFile_ > 1)
+   {
+      std::cerr << "Error: -o needs a single output kind\n";
+      return 1;
+   }
+   
+   // an ahead of time compile does not run the top level expressions, unless asked to
+   bool emit = cnf.saveAsObjectFile_ || cnf.saveAsAsmFile_ || cnf.saveAsIRFile_ || cnf.saveAsBitcodeFile_;
+   if (emit && !jitOption)
+      cnf.enableJit_ = false;
+   
+   driver::Driver driver{cnf};
+   return driver.go();
 }